@@ -15,26 +15,50 @@ void LocalDescriptorAndBagOfFeature::FindCodewords(std::vector<std::vector<doubl
     std::cout << "compactness for kmeans: " << compactness << std::endl;
 }
 
-void LocalDescriptorAndBagOfFeature::SaveCodebook(std::string filename, const std::vector<std::vector<double>> &codebook){
-    std::ofstream fileout (filename);
-    fileout << codebook.size() << std::endl;
-    for(const std::vector<double>& code_vector : codebook){
-         for(const double& d : code_vector){
-             fileout << d << " ";
-         }
-         fileout << std::endl;
+//flat vocabulary using approximate k-means, for vocabularies too large for exact assignment
+void LocalDescriptorAndBagOfFeature::FindApproximateCodewords(std::vector<std::vector<double> > &features, int numCodeWords, std::vector<std::vector<double> > &codewords, int iterationCap, int epsilon, int trees, int checks)
+{
+    std::vector<int> labels, sizes;
+    double compactness = approximate_kmeans(features, numCodeWords, labels, codewords, sizes, iterationCap, epsilon, trees, checks);
+    std::cout << "compactness for approximate kmeans: " << compactness << std::endl;
+}
+
+void LocalDescriptorAndBagOfFeature::SaveCodebook(std::string filename, const std::vector<std::vector<double>> &codebook, const feature_parameters &parameters){
+    if(!matrix_container::save(filename, CODEBOOK_CONTAINER, codebook, std::vector<std::string>(), parameters))
+        std::cout << "can't save codebook to " << filename << std::endl;
+}
+
+bool LocalDescriptorAndBagOfFeature::LoadCodebook(std::string filename, std::vector<std::vector<double>> &codebook, feature_parameters *parameters){
+    if(!matrix_container::is_container(filename))
+        return ImportCodebook(filename, codebook);
+
+    matrix_container container;
+    if(!container.open(filename, CODEBOOK_CONTAINER))
+        return false;
+    if(container.rows().rows == 0){
+        std::cout << "codebook " << filename << " holds no codewords" << std::endl;
+        return false;
     }
-    fileout.close();
+
+    container.copy_rows(codebook);
+    if(parameters != NULL)
+        *parameters = container.parameters();
+    return true;
 }
 
-void LocalDescriptorAndBagOfFeature::LoadCodebook(std::string filename, std::vector<std::vector<double>> &codebook){
+//reads the text format written before the binary container, one codeword per line
+bool LocalDescriptorAndBagOfFeature::ImportCodebook(std::string filename, std::vector<std::vector<double>> &codebook){
     //load codebook from file
     std::ifstream filein (filename);
+    if(!filein){
+        std::cout << "can't open codebook " << filename << std::endl;
+        return false;
+    }
     std::string s;
     std::getline(filein, s);
     std::istringstream sin(s);
 
-    int codeword_ct;
+    int codeword_ct = 0;
     sin >> codeword_ct;
 
     for(int i = 0; i < codeword_ct; i++){
@@ -53,6 +77,12 @@ void LocalDescriptorAndBagOfFeature::LoadCodebook(std::string filename, std::vec
             codebook.push_back(codeword);
     }
     filein.close();
+
+    if(codebook.empty()){
+        std::cout << "codebook " << filename << " holds no codewords" << std::endl;
+        return false;
+    }
+    return true;
 }
 
 void LocalDescriptorAndBagOfFeature::SaveVocabularyTree(std::ofstream &fileout, const tree_node &root, int K, int L){
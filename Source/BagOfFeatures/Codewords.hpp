@@ -2,13 +2,18 @@
 #include <vector>
 #include <string>
 #include "../Util/Clustering.hpp"
+#include "../Util/MatrixContainer.hpp"
 
 namespace LocalDescriptorAndBagOfFeature 
 {
     void FindCodewords(std::vector<std::vector<double>> &features, int numCodeWords, std::vector<std::vector<double>> &codewords);
     void FindCodewords(std::vector<std::vector<double>> &features, int numCodeWords, std::vector<std::vector<double>> &codewords, int iterationCap, int epsilon, int trials);
-    void SaveCodebook(std::string filename, const std::vector<std::vector<double>> &codebook);
-    void LoadCodebook(std::string filename, std::vector<std::vector<double>> &codebook);
+    void FindApproximateCodewords(std::vector<std::vector<double>> &features, int numCodeWords, std::vector<std::vector<double>> &codewords, int iterationCap, int epsilon, int trees, int checks);
+    // Codebooks are written as binary containers, LoadCodebook also accepts the old text format
+    // The loaders return false, leaving the codebook empty, when the file can't be read or holds no codewords
+    void SaveCodebook(std::string filename, const std::vector<std::vector<double>> &codebook, const feature_parameters &parameters = feature_parameters());
+    bool LoadCodebook(std::string filename, std::vector<std::vector<double>> &codebook, feature_parameters *parameters = NULL);
+    bool ImportCodebook(std::string filename, std::vector<std::vector<double>> &codebook);
 
     void SaveVocabularyTree(std::ofstream &fileout, const tree_node &root, int K, int L);
     void SaveVocabularyTree(std::string filename, const vocabulary_tree &tree);
@@ -114,13 +114,25 @@ int main(int argc, char **argv){
     //load codebook
     std::cout << "Load Codebook" << std::endl;
     std::vector<std::vector<double>> codebook;
-    LoadCodebook(codebook_filename, codebook);
+    if(!LoadCodebook(codebook_filename, codebook)){
+        return 1;
+    }
 
     //load nearest centroid classifier
     std::cout << "Load Classifier" << std::endl;
     std::vector<std::string> category_labels;
     std::vector<std::vector<double>> category_centroids;
-    load_classifier(classifier_filename, category_labels, category_centroids);
+    feature_parameters classifier_parameters;
+    if(!load_classifier(classifier_filename, category_labels, category_centroids, &classifier_parameters)){
+        return 1;
+    }
+
+    //text classifiers carry no settings, binary ones are checked against this run
+    if(!classifier_parameters.detector.empty() && (classifier_parameters.detector != detector_type
+            || classifier_parameters.descriptor != descriptor_type || classifier_parameters.quantization != quantization_type)){
+        std::cout << "warning: classifier was trained with detector=" << classifier_parameters.detector << ", descriptor=" << classifier_parameters.descriptor
+                  << ", quantization=" << classifier_parameters.quantization << std::endl;
+    }
 
     cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create(detector_type);
     if(detector_type.compare("Dense") == 0){
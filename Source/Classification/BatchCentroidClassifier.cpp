@@ -0,0 +1,113 @@
+#include "BatchCentroidClassifier.hpp"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <iostream>
+#include <assert.h>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    cv::Mat stack(const std::vector<Histogram> &samples, int dim){
+        cv::Mat stacked(samples.size(), dim, CV_64F);
+        for(size_t i = 0; i < samples.size(); i++){
+            assert((int)samples[i].size() == dim);
+            std::copy(samples[i].begin(), samples[i].end(), stacked.ptr<double>(i));
+        }
+        return stacked;
+    }
+}
+
+BatchCentroidClassifier::BatchCentroidClassifier(const std::vector<std::vector<double>> &category_centroids, int block_size)
+    : block_size(std::max(block_size, 1))
+{
+    if(category_centroids.empty()){
+        std::cout << "BatchCentroidClassifier needs at least one centroid" << std::endl;
+    }
+    int dim = category_centroids.empty() ? 0 : category_centroids[0].size();
+    centroids = stack(category_centroids, dim);
+    centroid_norms.resize(centroids.rows);
+    for(int j = 0; j < centroids.rows; j++){
+        const double *c = centroids.ptr<double>(j);
+        centroid_norms[j] = std::inner_product(c, c + dim, c, 0.0);
+    }
+}
+
+void BatchCentroidClassifier::squared_distances(const cv::Mat &samples, int begin, int end, cv::Mat &distances) const{
+    cv::Mat block = samples.rowRange(begin, end), converted;
+    if(block.type() != CV_64F){
+        block.convertTo(converted, CV_64F);
+        block = converted;
+    }
+
+    //-2 x.c for the whole block, then the norms
+    cv::gemm(block, centroids, -2, cv::Mat(), 0, distances, cv::GEMM_2_T);
+    for(int i = 0; i < distances.rows; i++){
+        const double *x = block.ptr<double>(i);
+        double norm = std::inner_product(x, x + block.cols, x, 0.0);
+        double *d = distances.ptr<double>(i);
+        for(int j = 0; j < distances.cols; j++){
+            d[j] = std::max(d[j] + norm + centroid_norms[j], 0.0);
+        }
+    }
+}
+
+void BatchCentroidClassifier::classify(const cv::Mat &samples, std::vector<int> &categories) const{
+    assert(samples.cols == centroids.cols);
+    //without centroids there is no nearest one
+    assert(is_valid());
+    if(!is_valid()){
+        categories.assign(samples.rows, -1);
+        return;
+    }
+    categories.resize(samples.rows);
+    int blocks = (samples.rows + block_size - 1) / block_size;
+
+#pragma omp parallel for schedule(dynamic)
+    for(int b = 0; b < blocks; b++){
+        int begin = b * block_size, end = std::min(begin + block_size, samples.rows);
+        cv::Mat distances;
+        squared_distances(samples, begin, end, distances);
+        for(int i = 0; i < distances.rows; i++){
+            const double *d = distances.ptr<double>(i);
+            categories[begin + i] = std::min_element(d, d + distances.cols) - d;
+        }
+    }
+}
+
+void BatchCentroidClassifier::classify(const std::vector<Histogram> &samples, std::vector<int> &categories) const{
+    classify(stack(samples, centroids.cols), categories);
+}
+
+void BatchCentroidClassifier::nearest(const cv::Mat &samples, int k, cv::Mat &categories, cv::Mat &distances) const{
+    assert(samples.cols == centroids.cols);
+    k = std::max(0, std::min(k, centroids.rows));
+    categories.create(samples.rows, k, CV_32S);
+    distances.create(samples.rows, k, CV_64F);
+    int blocks = (samples.rows + block_size - 1) / block_size;
+
+#pragma omp parallel for schedule(dynamic)
+    for(int b = 0; b < blocks; b++){
+        int begin = b * block_size, end = std::min(begin + block_size, samples.rows);
+        cv::Mat block_distances;
+        squared_distances(samples, begin, end, block_distances);
+
+        std::vector<int> order(centroids.rows);
+        for(int i = 0; i < block_distances.rows; i++){
+            const double *d = block_distances.ptr<double>(i);
+            std::iota(order.begin(), order.end(), 0);
+            std::partial_sort(order.begin(), order.begin() + k, order.end(), [d](int a, int c){ return d[a] < d[c] || (d[a] == d[c] && a < c); });
+
+            int *category = categories.ptr<int>(begin + i);
+            double *distance = distances.ptr<double>(begin + i);
+            for(int j = 0; j < k; j++){
+                category[j] = order[j];
+                distance[j] = std::sqrt(d[order[j]]);
+            }
+        }
+    }
+}
+
+void BatchCentroidClassifier::nearest(const std::vector<Histogram> &samples, int k, cv::Mat &categories, cv::Mat &distances) const{
+    nearest(stack(samples, centroids.cols), k, categories, distances);
+}
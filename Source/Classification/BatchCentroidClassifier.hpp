@@ -0,0 +1,37 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "../Util/Types.hpp"
+
+namespace LocalDescriptorAndBagOfFeature
+{
+    //nearest-centroid classification of whole batches: the centroids are stacked into one matrix with their
+    //squared norms, so the squared distances of a block of histograms to every centroid are
+    //|x|^2 + |c|^2 - 2 x.c with all cross terms from one matrix product; blocks are scored on separate threads
+    //an empty centroid set leaves the classifier invalid and classifying with it is an error
+    class BatchCentroidClassifier {
+        public:
+            BatchCentroidClassifier(const std::vector<std::vector<double>> &category_centroids, int block_size = 256);
+
+            //samples are rows (CV_32F or CV_64F), categories gets the index of the nearest centroid of each row
+            void classify(const cv::Mat &samples, std::vector<int> &categories) const;
+            void classify(const std::vector<Histogram> &samples, std::vector<int> &categories) const;
+
+            //the k nearest centroids of each row, nearest first: categories (CV_32S) and their euclidean
+            //distances (CV_64F) are samples.rows x k, k clamped to [0, size()]
+            void nearest(const cv::Mat &samples, int k, cv::Mat &categories, cv::Mat &distances) const;
+            void nearest(const std::vector<Histogram> &samples, int k, cv::Mat &categories, cv::Mat &distances) const;
+
+            bool is_valid() const { return centroids.rows > 0; }
+            int size() const { return centroids.rows; }
+            int dimension() const { return centroids.cols; }
+
+        private:
+            //squared distances of rows [begin, end) of samples to every centroid, (end - begin) x size()
+            void squared_distances(const cv::Mat &samples, int begin, int end, cv::Mat &distances) const;
+
+            cv::Mat centroids;
+            std::vector<double> centroid_norms;
+            int block_size;
+    };
+}
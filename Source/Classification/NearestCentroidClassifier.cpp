@@ -1,17 +1,20 @@
 #include "NearestCentroidClassifier.hpp"
+#include "BatchCentroidClassifier.hpp"
 #include "../Util/Distances.hpp"
 #include <fstream>
 #include <sstream>
-#include <time.h>
-
-//gets centroid for category from training images
-void LocalDescriptorAndBagOfFeature::train_category(const std::vector<cv::Mat> &samples, Histogram &centroid, const cv::Ptr<cv::FeatureDetector> &detector, const cv::SiftDescriptorExtractor &extractor, Quantization *quant){
-    clock_t start = clock();
-    int i = 0;
-    for(const cv::Mat& sample : samples){
-        i++;
-        std::cout << "converting img " << i << " of " << samples.size() << " to bag of features" << std::endl;
-
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    //detect, describe and quantize one image
+    void image_histogram(const cv::Mat &sample, Histogram &feature_vector, const cv::Ptr<cv::FeatureDetector> &detector, const cv::SiftDescriptorExtractor &extractor, Quantization *quant){
         //detect keypoints
         std::vector<cv::KeyPoint> keypoints;
         detector->detect( sample, keypoints );
@@ -28,28 +31,84 @@ void LocalDescriptorAndBagOfFeature::train_category(const std::vector<cv::Mat> &
         convert_mat_to_vector(descriptor_double, unquantized_features);
 
         //quantize regions -- true BagOfFeatures
-        Histogram feature_vector;
         quant->quantize(unquantized_features, feature_vector);
+    }
+
+    struct image_shard {
+        int category, begin, end;
+    };
+}
 
-        //aggregate
-        vector_add(centroid, feature_vector);
+//gets centroid for category from training images
+void LocalDescriptorAndBagOfFeature::train_category(const std::vector<cv::Mat> &samples, Histogram &centroid, const cv::Ptr<cv::FeatureDetector> &detector, const cv::SiftDescriptorExtractor &extractor, Quantization *quant){
+    std::vector<std::vector<cv::Mat>> categories(1, samples);
+    std::vector<Histogram> centroids;
+    train_categories(categories, centroids, centroid.size(), detector, extractor, quant);
+    centroid = centroids[0];
+}
+
+//gets centroids for all categories at once, the images of each category are split into one contiguous shard per
+//thread and all shards run concurrently, each summing into its own accumulator; the shards are reduced in order
+//so the result does not depend on thread scheduling
+void LocalDescriptorAndBagOfFeature::train_categories(const std::vector<std::vector<cv::Mat>> &samples, std::vector<Histogram> &centroids, int vocabulary_size, const cv::Ptr<cv::FeatureDetector> &detector, const cv::SiftDescriptorExtractor &extractor, Quantization *quant){
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    std::vector<image_shard> shards;
+    int images = 0;
+    for(int c = 0; c < samples.size(); c++){
+        int n = samples[c].size();
+        int count = std::max(1, std::min(threads, n));
+        for(int s = 0; s < count; s++){
+            image_shard shard = { c, n * s / count, n * (s + 1) / count };
+            shards.push_back(shard);
+        }
+        images += n;
+    }
+
+    std::vector<Histogram> partial(shards.size(), Histogram(vocabulary_size, 0.0));
+#pragma omp parallel for schedule(dynamic)
+    for(int s = 0; s < (int)shards.size(); s++){
+        const std::vector<cv::Mat> &category = samples[shards[s].category];
+        Histogram feature_vector;
+        for(int i = shards[s].begin; i < shards[s].end; i++){
+            image_histogram(category[i], feature_vector, detector, extractor, quant);
+            vector_add(partial[s], feature_vector);
+        }
+    }
+
+    centroids.assign(samples.size(), Histogram(vocabulary_size, 0.0));
+    for(int s = 0; s < (int)shards.size(); s++){
+        vector_add(centroids[shards[s].category], partial[s]);
     }
 
     //divide by training category size to compute centroid
-    //std::transform(centroid.begin(), centroid.end(), centroid.begin(), std::bind1st(std::divides<double>(),bikes.size()));
-    for(double& d : centroid){
-        d = d/samples.size();
+    for(int c = 0; c < samples.size(); c++){
+        for(double& d : centroids[c]){
+            d = d/samples[c].size();
+        }
     }
-    std::cout << double( clock() - start ) / (double)CLOCKS_PER_SEC<< " seconds." << std::endl;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << images << " images in " << samples.size() << " categories, " << seconds << " seconds." << std::endl;
 }
 
 //given the feature-space histogram for an image, get the category by finding nearest centroid
+//squared distances are compared, without a temporary per centroid
 int LocalDescriptorAndBagOfFeature::get_category(const Histogram &feature_vector, const std::vector<std::vector<double>> &category_centroids){
     int closest_index = 0;
-    double closest_distance = euclidean_distance(category_centroids[0], feature_vector);
+    double closest_distance = std::numeric_limits<double>::infinity();
 
-    for(int i = 1; i < category_centroids.size(); i++){
-        double distance = euclidean_distance(category_centroids[i], feature_vector);
+    for(int i = 0; i < category_centroids.size(); i++){
+        assert(category_centroids[i].size() == feature_vector.size());
+        double distance = 0;
+        for(size_t k = 0; k < feature_vector.size(); k++){
+            double diff = category_centroids[i][k] - feature_vector[k];
+            distance += diff * diff;
+        }
         if(distance < closest_distance){
             closest_index = i;
             closest_distance = distance;
@@ -59,37 +118,54 @@ int LocalDescriptorAndBagOfFeature::get_category(const Histogram &feature_vector
     return closest_index;
 }
 
-//categorize images using nearest centroid and generate confusion table
+//categorize images using nearest centroid and generate confusion table, the whole set is scored as one batch
 void LocalDescriptorAndBagOfFeature::test_category(std::vector<Histogram> &feature_vectors, std::vector<double> &confusion_table, std::vector<std::string> &category_labels, std::vector<std::vector<double>> &category_centroids){
-    for(Histogram &feature_vector : feature_vectors){
-        int cat = get_category(feature_vector, category_centroids);
-        //std::cout << "image " << i << " of " << bikes.size() << ": " << cat << "-" << category_labels[cat] << std::endl;
+    BatchCentroidClassifier classifier(category_centroids);
+    std::vector<int> categories;
+    classifier.classify(feature_vectors, categories);
+    for(int cat : categories){
         confusion_table[cat]++;
     }
 }
 
-void LocalDescriptorAndBagOfFeature::save_classifier(std::string filename, const std::vector<std::vector<double>> &category_centroids, const std::vector<std::string> &category_labels){
-    std::ofstream fileout (filename);
-    fileout << category_centroids.size() << std::endl;
-    for(int i = 0; i < category_centroids.size(); i++){
-        fileout << category_labels[i] << std::endl;
-        for(const double& d : category_centroids[i]){
-            fileout << d << " ";
-        }
-        fileout << std::endl;
-    }
-    fileout.close();
+void LocalDescriptorAndBagOfFeature::save_classifier(std::string filename, const std::vector<std::vector<double>> &category_centroids, const std::vector<std::string> &category_labels, const feature_parameters &parameters){
+    if(!matrix_container::save(filename, CLASSIFIER_CONTAINER, category_centroids, category_labels, parameters))
+        std::cout << "can't save classifier to " << filename << std::endl;
 }
 
 //gets a centroid classifier trained from test data
-void LocalDescriptorAndBagOfFeature::load_classifier(std::string filename, std::vector<std::string> &category_labels, std::vector<std::vector<double>> &category_centroids){
+bool LocalDescriptorAndBagOfFeature::load_classifier(std::string filename, std::vector<std::string> &category_labels, std::vector<std::vector<double>> &category_centroids, feature_parameters *parameters){
+    if(!matrix_container::is_container(filename))
+        return import_classifier(filename, category_labels, category_centroids);
+
+    matrix_container container;
+    if(!container.open(filename, CLASSIFIER_CONTAINER))
+        return false;
+    if(container.rows().rows == 0 || container.labels().size() != (size_t)container.rows().rows){
+        std::cout << "classifier " << filename << " holds no labelled centroids" << std::endl;
+        return false;
+    }
+
+    category_labels = container.labels();
+    container.copy_rows(category_centroids);
+    if(parameters != NULL)
+        *parameters = container.parameters();
+    return true;
+}
+
+//reads the text format written before the binary container, a label line and a centroid line per category
+bool LocalDescriptorAndBagOfFeature::import_classifier(std::string filename, std::vector<std::string> &category_labels, std::vector<std::vector<double>> &category_centroids){
     //load codebook from file
     std::ifstream filein (filename);
+    if(!filein){
+        std::cout << "can't open classifier " << filename << std::endl;
+        return false;
+    }
     std::string s;
     std::getline(filein, s);
     std::istringstream sin(s);
 
-    int category_ct;
+    int category_ct = 0;
     sin >> category_ct;
 
     for(int i = 0; i < category_ct; i++){
@@ -108,4 +184,10 @@ void LocalDescriptorAndBagOfFeature::load_classifier(std::string filename, std::
         category_centroids.push_back(centroid);
     }
     filein.close();
+
+    if(category_centroids.empty() || category_centroids[0].empty()){
+        std::cout << "classifier " << filename << " holds no centroids" << std::endl;
+        return false;
+    }
+    return true;
 }
@@ -7,14 +7,19 @@
 #include <opencv2/nonfree/features2d.hpp>
 #include "../Quantization/Quantization.hpp"
 #include "../Util/Types.hpp"
+#include "../Util/MatrixContainer.hpp"
 
 namespace LocalDescriptorAndBagOfFeature
 {
     void train_category(const std::vector<cv::Mat> &samples, Histogram &centroid, const cv::Ptr<cv::FeatureDetector> &detector, const cv::SiftDescriptorExtractor &extractor, Quantization *quant);
+    void train_categories(const std::vector<std::vector<cv::Mat>> &samples, std::vector<Histogram> &centroids, int vocabulary_size, const cv::Ptr<cv::FeatureDetector> &detector, const cv::SiftDescriptorExtractor &extractor, Quantization *quant);
 
     int get_category(const Histogram &feature_vector, const std::vector<std::vector<double>> &category_centroids);
     void test_category(std::vector<Histogram> &feature_vectors, std::vector<double> &confusion_table, std::vector<std::string> &category_labels, std::vector<std::vector<double>> &category_centroids);
 
-    void save_classifier(std::string filename, const std::vector<std::vector<double>> &category_centroids, const std::vector<std::string> &category_labels);
-    void load_classifier(std::string filename, std::vector<std::string> &category_labels, std::vector<std::vector<double>> &category_centroids);
+    //classifiers are written as binary containers with the labels attached, load_classifier also accepts the old text format
+    //the loaders return false when the file can't be read or holds no centroids
+    void save_classifier(std::string filename, const std::vector<std::vector<double>> &category_centroids, const std::vector<std::string> &category_labels, const feature_parameters &parameters = feature_parameters());
+    bool load_classifier(std::string filename, std::vector<std::string> &category_labels, std::vector<std::vector<double>> &category_centroids, feature_parameters *parameters = NULL);
+    bool import_classifier(std::string filename, std::vector<std::string> &category_labels, std::vector<std::vector<double>> &category_centroids);
 }
@@ -76,19 +76,29 @@ int main(int argc, char **argv){
     //Load codebook
     std::cout << "Load Codebook" << std::endl;
     std::vector<std::vector<double>> codebook;
-    LoadCodebook(codebook_filename, codebook);
+    if(!LoadCodebook(codebook_filename, codebook)){
+        return 1;
+    }
 
     //Train nearest centroid classifier
     std::vector<std::vector<double>> category_centroids;
 
+    //settings recorded in the classifier file
+    feature_parameters parameters;
+    parameters.detector = detector_type;
+    parameters.descriptor = descriptor_type;
+    parameters.quantization = quantization_type;
+
     cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create(detector_type);
     if(detector_type.compare("Dense") == 0){
         //detector->set("featureScaleLevels", 1);
         //detector->set("featureScaleMul", 0.1f);
         //detector->set("initFeatureScale", 1.f);
         detector->set("initXyStep", 25); //15 for scene15, 30 for graz2
+        parameters.step = 25;
     } else if(detector_type.compare("SIFT") == 0){
         detector->set("nFeatures", 200);
+        parameters.features = 200;
     }
 
     cv::SiftDescriptorExtractor extractor; //sift128 descriptor
@@ -114,15 +124,12 @@ int main(int argc, char **argv){
         vocabulary_size = tree_quant.size(); //tree size
     }
 
-    for(int i = 0; i < training_images.size(); i++){
-        std::cout << "Training " << category_labels[i] << std::endl;
-        Histogram centroid(vocabulary_size);
-        train_category(training_images[i],centroid, detector, extractor, quant);
-        category_centroids.push_back(centroid);
-    }
+    //all categories train concurrently
+    std::cout << "Training " << training_images.size() << " categories" << std::endl;
+    train_categories(training_images, category_centroids, vocabulary_size, detector, extractor, quant);
 
     //write classifier to file
-    save_classifier(output_filename, category_centroids, category_labels);
+    save_classifier(output_filename, category_centroids, category_labels, parameters);
 
     return 0;
 }
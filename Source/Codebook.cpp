@@ -83,14 +83,21 @@ int main(int argc, char **argv){
 
     cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create(detector_type);
 
+    //settings recorded in the codebook file
+    feature_parameters parameters;
+    parameters.detector = detector_type;
+    parameters.descriptor = descriptor_type;
+
     //at the moment user cannot set these from the command line
     if(detector_type.compare("Dense") == 0){
         //detector->set("featureScaleLevels", 1);
         //detector->set("featureScaleMul", 0.1f);
         //detector->set("initFeatureScale", 1.f);
         detector->set("initXyStep", 25); //for graz2, 30 gets ~352 per image, for scene15, 15 gets ~314
+        parameters.step = 25;
     } else if(detector_type.compare("SIFT") == 0){
         detector->set("nFeatures", 200);
+        parameters.features = 200;
     }
 
 
@@ -160,7 +167,7 @@ int main(int argc, char **argv){
     std::cout << double( clock() - start ) / (double)CLOCKS_PER_SEC<< " seconds." << std::endl;
 
     //5. write codebook to file
-    SaveCodebook(output_filename, centers);
+    SaveCodebook(output_filename, centers, parameters);
 */
     return 0;
 }
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "BagOfFeatures/Codewords.hpp"
+#include "Classification/NearestCentroidClassifier.hpp"
+#include "Util/MatrixContainer.hpp"
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+//imports a text codebook or classifier into the binary container format, the settings are recorded in the header
+int main(int argc, char **argv){
+    std::string error = "Invalid arguments. Usage: {codebook, classifier} text-input binary-output [detector descriptor [quantization]]";
+    if(argc < 4 || argc > 7){
+        std::cout << error << std::endl;
+        return 1;
+    }
+
+    std::string kind(argv[1]);
+    feature_parameters parameters;
+    if(argc > 4)
+        parameters.detector = argv[4];
+    if(argc > 5)
+        parameters.descriptor = argv[5];
+    if(argc > 6)
+        parameters.quantization = argv[6];
+
+    std::vector<std::vector<double>> rows;
+    std::vector<std::string> labels;
+    container_kind container;
+    bool imported;
+    if(kind.compare("codebook") == 0){
+        imported = ImportCodebook(argv[2], rows);
+        container = CODEBOOK_CONTAINER;
+    } else if(kind.compare("classifier") == 0){
+        imported = import_classifier(argv[2], labels, rows);
+        container = CLASSIFIER_CONTAINER;
+    } else {
+        std::cout << error << std::endl;
+        return 1;
+    }
+
+    if(!imported){
+        return 1;
+    }
+
+    if(!matrix_container::save(argv[3], container, rows, labels, parameters)){
+        std::cout << "can't save container to file " << argv[3] << std::endl;
+        return 1;
+    }
+    std::cout << "converted " << rows.size() << " rows of dimension " << rows[0].size() << " from " << argv[2] << " to " << argv[3] << std::endl;
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include <iostream>
+#include <string>
+#include "SVM/svm.h"
+
+//converts a libsvm model between the text format and the memory-mapped binary format, the input format is detected
+int main(int argc, char **argv){
+    std::string error = "Invalid arguments. Usage: input-model output-model";
+    if(argc != 3){
+        std::cout << error << std::endl;
+        return 1;
+    }
+
+    bool binary = svm_is_binary_model(argv[1]);
+    svm_model *model = svm_load_model(argv[1]);
+    if(model == NULL){
+        std::cout << "can't open model file " << argv[1] << std::endl;
+        return 1;
+    }
+
+    int status = binary ? svm_save_model(argv[2], model) : svm_save_model_binary(argv[2], model);
+    if(status != 0){
+        std::cout << "can't save model to file " << argv[2] << std::endl;
+    } else {
+        std::cout << "converted " << (binary ? "binary" : "text") << " model " << argv[1] << " to " << (binary ? "text" : "binary") << " model " << argv[2] << std::endl;
+    }
+
+    svm_free_and_destroy_model(&model);
+    return status != 0;
+}
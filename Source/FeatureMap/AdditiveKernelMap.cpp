@@ -0,0 +1,89 @@
+#include "AdditiveKernelMap.hpp"
+#include <cmath>
+#include <assert.h>
+#include <algorithm>
+
+#ifndef M_PI
+#   define M_PI 3.14159265358979323846
+#endif
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    //spectra of the kernel signatures, chi-squared being 2xy/(x+y)
+    double spectrum(HistogramKernel kernel, double omega){
+        switch(kernel){
+            case ChiSquaredKernel:
+                return 1 / std::cosh(M_PI * omega);
+            case IntersectionKernel:
+                return 2 / (M_PI * (1 + 4 * omega * omega));
+            default:
+                return 0;
+        }
+    }
+}
+
+AdditiveKernelMap::AdditiveKernelMap(HistogramKernel kernel, int order, double period)
+    : kernel(kernel), order(kernel == HellingerKernel ? 0 : order)
+{
+    if(period <= 0){
+        period = kernel == IntersectionKernel ? 8.80 * std::sqrt(order + 4.44) - 12.6 : 5.86 * std::sqrt((double)order) + 3.65;
+        period = std::max(period, 1.0);
+    }
+    step = 2 * M_PI / period;
+
+    coefficients.push_back(kernel == HellingerKernel ? 1 : std::sqrt(step * spectrum(kernel, 0)));
+    for(int j = 1; j <= this->order; j++){
+        coefficients.push_back(std::sqrt(2 * step * spectrum(kernel, j * step)));
+    }
+}
+
+int AdditiveKernelMap::output_dimension(int input_dimension) const {
+    return input_dimension * (2 * order + 1);
+}
+
+template <typename T> void AdditiveKernelMap::map_row(const T *x, int dim, float *out) const {
+    int width = 2 * order + 1;
+    for(int d = 0; d < dim; d++, out += width){
+        double v = x[d];
+        if(v <= 0){
+            std::fill(out, out + width, 0.0f);
+            continue;
+        }
+
+        double root = std::sqrt(v);
+        out[0] = (float)(coefficients[0] * root);
+        if(order == 0){
+            continue;
+        }
+
+        //cos/sin of j*theta by the angle addition recurrence, one log and one sincos per bin
+        double theta = step * std::log(v);
+        double c1 = std::cos(theta), s1 = std::sin(theta);
+        double c = c1, s = s1;
+        for(int j = 1; j <= order; j++){
+            double scale = coefficients[j] * root;
+            out[2*j - 1] = (float)(scale * c);
+            out[2*j] = (float)(scale * s);
+
+            double next = c * c1 - s * s1;
+            s = s * c1 + c * s1;
+            c = next;
+        }
+    }
+}
+
+void AdditiveKernelMap::map(const cv::Mat &histograms, cv::Mat &features) const {
+    assert(histograms.type() == CV_32F || histograms.type() == CV_64F);
+    int dim = histograms.cols;
+    features.create(histograms.rows, output_dimension(dim), CV_32F);
+
+#pragma omp parallel for schedule(static)
+    for(int i = 0; i < histograms.rows; i++){
+        if(histograms.type() == CV_32F){
+            map_row(histograms.ptr<float>(i), dim, features.ptr<float>(i));
+        } else {
+            map_row(histograms.ptr<double>(i), dim, features.ptr<float>(i));
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "FeatureMap.hpp"
+
+namespace LocalDescriptorAndBagOfFeature
+{
+    //homogeneous kernel map (Vedaldi and Zisserman) for the additive histogram kernels:
+    //each bin x becomes 2*order+1 values sqrt(x L k(jL)) {cos, sin}(jL log x), j = 0..order,
+    //k the spectrum of the kernel, L the sampling step
+    //Hellinger is exact with a single value sqrt(x), order is ignored for it
+    //period <= 0 picks the period VLFeat uses for the order
+    class AdditiveKernelMap : public FeatureMap
+    {
+        public:
+            AdditiveKernelMap(HistogramKernel kernel, int order = 1, double period = 0);
+            int output_dimension(int input_dimension) const;
+            void map(const cv::Mat &histograms, cv::Mat &features) const;
+            using FeatureMap::map;
+
+        private:
+            template <typename T> void map_row(const T *x, int dim, float *out) const;
+
+            HistogramKernel kernel;
+            int order;
+            double step;
+            //sqrt(L k(0)), sqrt(2 L k(jL)) for j = 1..order
+            std::vector<double> coefficients;
+    };
+}
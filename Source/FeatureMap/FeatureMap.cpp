@@ -0,0 +1,22 @@
+#include "FeatureMap.hpp"
+#include "AdditiveKernelMap.hpp"
+#include "RandomFourierMap.hpp"
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+void FeatureMap::map(const std::vector<Histogram> &histograms, cv::Mat &features) const {
+    cv::Mat packed(histograms.size(), histograms.empty() ? 0 : histograms[0].size(), CV_64F);
+    for(size_t i = 0; i < histograms.size(); i++){
+        std::copy(histograms[i].begin(), histograms[i].end(), packed.ptr<double>(i));
+    }
+    map(packed, features);
+}
+
+cv::Ptr<FeatureMap> FeatureMap::create(const std::string &type, HistogramKernel kernel, int input_dimension, double gamma){
+    if(type.compare("additive") == 0){
+        return cv::Ptr<FeatureMap>(new AdditiveKernelMap(kernel));
+    } else if(type.compare("fourier") == 0){
+        return cv::Ptr<FeatureMap>(new RandomFourierMap(input_dimension, 10 * input_dimension, gamma));
+    }
+    return cv::Ptr<FeatureMap>();
+}
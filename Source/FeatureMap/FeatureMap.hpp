@@ -0,0 +1,26 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <string>
+#include "../Util/Types.hpp"
+
+namespace LocalDescriptorAndBagOfFeature
+{
+    //explicit feature map between the quantizers and a linear classifier: a dot product of mapped
+    //histograms approximates a non-linear kernel on the histograms
+    //input is one histogram per row (CV_32F or CV_64F), output is a contiguous CV_32F matrix of the same row count
+    class FeatureMap
+    {
+        public:
+            virtual ~FeatureMap() {}
+
+            //"additive" is the AdditiveKernelMap of kernel (order 1), "fourier" a RandomFourierMap with 10 outputs per
+            //input and seed 0, "none" and unknown types give an empty pointer; equal arguments give equal maps,
+            //so the programs that train and the ones that write test problems only have to agree on them
+            static cv::Ptr<FeatureMap> create(const std::string &type, HistogramKernel kernel, int input_dimension, double gamma = 1);
+
+            virtual int output_dimension(int input_dimension) const = 0;
+            virtual void map(const cv::Mat &histograms, cv::Mat &features) const = 0;
+            void map(const std::vector<Histogram> &histograms, cv::Mat &features) const;
+    };
+}
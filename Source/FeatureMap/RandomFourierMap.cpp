@@ -0,0 +1,52 @@
+#include "RandomFourierMap.hpp"
+#include <random>
+#include <cmath>
+#include <assert.h>
+
+#ifndef M_PI
+#   define M_PI 3.14159265358979323846
+#endif
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+RandomFourierMap::RandomFourierMap(int input_dimension, int output_dimension, double gamma, unsigned int seed)
+    : projection(input_dimension, output_dimension, CV_32F), phase(output_dimension)
+{
+    std::mt19937 generator(seed);
+    std::normal_distribution<float> normal(0, std::sqrt(2 * gamma));
+    std::uniform_real_distribution<float> uniform(0, 2 * M_PI);
+
+    for(int i = 0; i < input_dimension; i++){
+        float *row = projection.ptr<float>(i);
+        for(int j = 0; j < output_dimension; j++){
+            row[j] = normal(generator);
+        }
+    }
+    for(int j = 0; j < output_dimension; j++){
+        phase[j] = uniform(generator);
+    }
+}
+
+int RandomFourierMap::output_dimension(int) const {
+    return projection.cols;
+}
+
+void RandomFourierMap::map(const cv::Mat &histograms, cv::Mat &features) const {
+    assert(histograms.cols == projection.rows);
+
+    //the projection of the whole batch is one gemm, the cosines are applied row by row
+    cv::Mat x;
+    histograms.convertTo(x, CV_32F);
+    cv::gemm(x, projection, 1, cv::Mat(), 0, features);
+
+    int D = projection.cols;
+    float scale = std::sqrt(2.0f / D);
+    const float *b = phase.data();
+#pragma omp parallel for schedule(static)
+    for(int i = 0; i < features.rows; i++){
+        float *row = features.ptr<float>(i);
+        for(int j = 0; j < D; j++){
+            row[j] = scale * std::cos(row[j] + b[j]);
+        }
+    }
+}
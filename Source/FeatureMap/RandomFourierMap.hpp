@@ -0,0 +1,22 @@
+#pragma once
+#include "FeatureMap.hpp"
+
+namespace LocalDescriptorAndBagOfFeature
+{
+    //random Fourier features (Rahimi and Recht) for the RBF kernel exp(-gamma |x - y|^2):
+    //z(x) = sqrt(2/D) cos(W^T x + b), W ~ N(0, 2 gamma), b ~ U[0, 2 pi)
+    //the approximation improves with the number of output features D, a fixed seed gives a reproducible map
+    class RandomFourierMap : public FeatureMap
+    {
+        public:
+            RandomFourierMap(int input_dimension, int output_dimension, double gamma, unsigned int seed = 0);
+            int output_dimension(int input_dimension) const;
+            void map(const cv::Mat &histograms, cv::Mat &features) const;
+            using FeatureMap::map;
+
+        private:
+            //input_dimension x output_dimension projections and one phase per output
+            cv::Mat projection;
+            std::vector<float> phase;
+    };
+}
@@ -0,0 +1,123 @@
+#include "FisherVector.hpp"
+#include <cmath>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+FisherVector::FisherVector(const GMM &gmm, double pruneThreshold)
+    : _Gmm(gmm.Clone()), _PruneThreshold(pruneThreshold)
+{
+    // An untrained model has no gaussians (or no means yet), its encoding is empty
+    if(_Gmm.NumGaussians() == 0 || _Gmm.Gaussian(0).Mean().empty())
+        return;
+    
+    int K = _Gmm.NumGaussians();
+    int d = _Gmm.Gaussian(0).Mean().rows;
+    
+    _Means.create(K, d, CV_64F);
+    _InvSigma.create(K, d, CV_64F);
+    for(int k = 0; k < K; k++)
+    {
+        const WeightedGaussian &g = _Gmm.Gaussian(k);
+        cv::Mat variances = g.IsDiagonal() ? g.Covariance() : g.Covariance().diag();
+        
+        cv::Mat(g.Mean().t()).copyTo(_Means.row(k));
+        for(int i = 0; i < d; i++)
+        {
+            _InvSigma.at<double>(k, i) = 1.0 / std::sqrt(std::max(variances.at<double>(i, 0), 1e-12));
+        }
+        
+        // A gaussian that dropped out during training contributes zeros
+        _FirstOrderScale.push_back(g.Weight() > 0 ? 1.0 / std::sqrt(g.Weight()) : 0.0);
+        _SecondOrderScale.push_back(g.Weight() > 0 ? 1.0 / std::sqrt(2.0 * g.Weight()) : 0.0);
+    }
+}
+
+std::vector<double> FisherVector::Encode(const BagOfFeatures &bof) const
+{
+    if(bof.empty())
+        return std::vector<double>(Size(), 0.0);
+    
+    cv::Mat descriptors(bof.size(), bof[0].size(), CV_64F);
+    for(size_t i = 0; i < bof.size(); i++)
+    {
+        std::copy(bof[i].begin(), bof[i].end(), descriptors.ptr<double>(i));
+    }
+    
+    return Encode(descriptors);
+}
+
+// Gradients of the log likelihood with respect to the means and standard deviations
+//   u_k = 1/(N sqrt(w_k))  sum_n g_nk (x_n - u_k) / s_k
+//   v_k = 1/(N sqrt(2w_k)) sum_n g_nk ((x_n - u_k)^2 / s_k^2 - 1)
+// followed by power (signed square root) and L2 normalization
+std::vector<double> FisherVector::Encode(const cv::Mat &descriptors) const
+{
+    int K = _Means.rows;
+    int d = _Means.cols;
+    int n = descriptors.rows;
+    if(K == 0)
+        return std::vector<double>();
+    if(n == 0)
+        return std::vector<double>(Size(), 0.0);
+    
+    cv::Mat samples;
+    descriptors.convertTo(samples, CV_64F);
+    
+    // All responsibilities in one batched E step, the GMM works on columns
+    cv::Mat gamma = _Gmm.Responsibilities(samples.t());
+    
+    std::vector<double> fv(2 * K * d, 0.0);
+    std::vector<double> S0(K, 0.0);
+    for(int i = 0; i < n; i++)
+    {
+        const double *x = samples.ptr<double>(i);
+        const double *gi = gamma.ptr<double>(i);
+        for(int k = 0; k < K; k++)
+        {
+            // Each descriptor only touches its few dominant gaussians
+            double g = gi[k];
+            if(g < _PruneThreshold)
+                continue;
+            
+            const double *u = _Means.ptr<double>(k);
+            const double *invSigma = _InvSigma.ptr<double>(k);
+            double *first = &fv[k * d];
+            double *second = &fv[(K + k) * d];
+            for(int j = 0; j < d; j++)
+            {
+                double z = (x[j] - u[j]) * invSigma[j];
+                first[j] += g * z;
+                second[j] += g * z * z;
+            }
+            S0[k] += g;
+        }
+    }
+    
+    for(int k = 0; k < K; k++)
+    {
+        double firstScale = _FirstOrderScale[k] / n;
+        double secondScale = _SecondOrderScale[k] / n;
+        for(int j = 0; j < d; j++)
+        {
+            fv[k * d + j] *= firstScale;
+            fv[(K + k) * d + j] = (fv[(K + k) * d + j] - S0[k]) * secondScale;
+        }
+    }
+    
+    // Power normalization then L2 normalization
+    double norm = 0;
+    for(double &v : fv)
+    {
+        v = v < 0 ? -std::sqrt(-v) : std::sqrt(v);
+        norm += v * v;
+    }
+    
+    norm = std::sqrt(norm);
+    if(norm > 0)
+    {
+        for(double &v : fv)
+            v /= norm;
+    }
+    
+    return fv;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "GMM.hpp"
+#include "../Util/Types.hpp"
+
+namespace LocalDescriptorAndBagOfFeature 
+{
+    // Improved Fisher vector (Perronnin et al.) of an image's descriptors against a diagonal GMM
+    // A full covariance model only contributes its variances
+    // The encoder keeps its own copy of the model, retraining or reloading the GMM afterwards does not affect it
+    class FisherVector
+    {
+        public:
+            FisherVector(const GMM &gmm, double pruneThreshold = 1e-4);
+            
+            // One descriptor per row, as produced by the descriptor extractor, no descriptors give a zero vector
+            // and a model without gaussians an empty one
+            std::vector<double> Encode(const cv::Mat &descriptors) const;
+            std::vector<double> Encode(const BagOfFeatures &bof) const;
+            
+            // K first order blocks followed by K second order blocks, each of the descriptor dimension
+            int Size(void) const { return 2 * _Means.rows * _Means.cols; }
+            
+        private:
+            GMM _Gmm;
+            double _PruneThreshold;
+            
+            // Per gaussian rows (KxD) and weights of the copied model
+            cv::Mat _Means;
+            cv::Mat _InvSigma;
+            std::vector<double> _FirstOrderScale;
+            std::vector<double> _SecondOrderScale;
+    };
+}
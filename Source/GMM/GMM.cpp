@@ -1,35 +1,204 @@
 #include "GMM.hpp"
 #include <cmath>
 #include <random>
+#include <limits>
+#include <fstream>
+#include <cstring>
+#include <iostream>
 #include "../Util/Clustering.hpp"
 
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
+
 #ifndef M_PI
 #   define M_PI 3.14159265358979323846
 #endif
 
 using namespace LocalDescriptorAndBagOfFeature;
 
+namespace
+{
+    // Number of samples evaluated together in the E step, bounds the size of the KxN temporaries
+    const int blockSize = 4096;
+    
+    // Variances are floored at this fraction of the data's variance in the same dimension (as VLFeat does),
+    // and never below minimumVariance for dimensions that are constant over the whole data
+    const double varianceFloorFraction = 1e-3;
+    const double minimumVariance = 1e-6;
+    
+    // Per dimension floor from the sum and sum of squares (Dx1) of count samples
+    cv::Mat VarianceFloor(const cv::Mat &sum, const cv::Mat &sumSquares, double count)
+    {
+        if(count <= 0)
+            return cv::Mat();
+        
+        cv::Mat floor(sum.rows, 1, CV_64F);
+        for(int i = 0; i < sum.rows; i++)
+        {
+            double mean = sum.at<double>(i, 0) / count;
+            double variance = sumSquares.at<double>(i, 0) / count - mean * mean;
+            floor.at<double>(i, 0) = std::max(varianceFloorFraction * variance, minimumVariance);
+        }
+        return floor;
+    }
+    
+    // Binary model layout: this 64 byte header followed by contiguous doubles
+    //   weights (K), log normalizers (K), means (KxD), covariances (KxDxD or KxD for diagonal), precisions (same as covariances)
+    struct ModelHeader
+    {
+        char Magic[8];
+        int Version;
+        int CovarianceType;
+        int NumGaussians;
+        int Dimension;
+        int OnlineSteps;    // Online updates applied so far, zero for a batch trained model
+        char Reserved[36];
+    };
+    static_assert(sizeof(ModelHeader) == 64, "the payload must stay 8 byte aligned");
+    
+    const char modelMagic[8] = { 'L', 'D', 'B', 'O', 'F', 'G', 'M', 'M' };
+    const int modelVersion = 1;
+    
+    // Statistics dump: this 64 byte header, then Count, LogLikelihood, N, X and XX as contiguous doubles
+    struct StatisticsHeader
+    {
+        char Magic[8];
+        int Version;
+        int CovarianceType;
+        int NumGaussians;
+        int Dimension;
+        char Reserved[40];
+    };
+    static_assert(sizeof(StatisticsHeader) == 64, "the payload must stay 8 byte aligned");
+    
+    const char statisticsMagic[8] = { 'L', 'D', 'B', 'O', 'F', 'G', 'S', 'T' };
+    const int statisticsVersion = 1;
+    
+    bool ValidCovarianceType(int type)
+    {
+        return type == FullCovariance || type == DiagonalCovariance;
+    }
+    
+    void WriteMat(std::ofstream &fileout, const cv::Mat &m)
+    {
+        cv::Mat continuous = m.isContinuous() ? m : m.clone();
+        fileout.write(reinterpret_cast<const char*>(continuous.data), continuous.total() * sizeof(double));
+    }
+    
+    // Lower triangular L with L * L^T = A, returns false if A is not positive definite
+    bool Cholesky(const cv::Mat &A, cv::Mat &L)
+    {
+        int n = A.rows;
+        L = cv::Mat::zeros(n, n, CV_64F);
+        for(int j = 0; j < n; j++)
+        {
+            double d = A.at<double>(j, j);
+            for(int k = 0; k < j; k++)
+                d -= L.at<double>(j, k) * L.at<double>(j, k);
+            
+            if(d <= 0)
+                return false;
+            
+            double ljj = std::sqrt(d);
+            L.at<double>(j, j) = ljj;
+            for(int i = j + 1; i < n; i++)
+            {
+                double v = A.at<double>(i, j);
+                for(int k = 0; k < j; k++)
+                    v -= L.at<double>(i, k) * L.at<double>(j, k);
+                L.at<double>(i, j) = v / ljj;
+            }
+        }
+        return true;
+    }
+}
+
+WeightedGaussian::WeightedGaussian(void)
+    : _Weight(0), _LogNormalizer(0)
+{
+    
+}
+
 WeightedGaussian::WeightedGaussian(double weight, const cv::Mat &mean, const cv::Mat &covariance)
     : _Weight(weight), _Mean(mean.clone()), _Covariance(covariance.clone())
 {
+    _Update();
+}
+
+void WeightedGaussian::SetCovariance(const cv::Mat &covariance, const cv::Mat &varianceFloor)
+{
+    _Covariance = covariance.clone();
+    for(int i = 0; i < varianceFloor.rows; i++)
+    {
+        double &variance = IsDiagonal() ? _Covariance.at<double>(i, 0) : _Covariance.at<double>(i, i);
+        variance = std::max(variance, varianceFloor.at<double>(i, 0));
+    }
+    _Update();
+}
+
+// Factors the covariance once, every evaluation then reuses the precision and log normalizer
+// A covariance that is not positive definite (e.g. constant descriptor dimensions in a cluster) gets a growing ridge
+void WeightedGaussian::_Update(void)
+{
+    int d = _Covariance.rows;
+    double ridge = 1e-9 * std::max(cv::sum(IsDiagonal() ? _Covariance : _Covariance.diag())[0] / d, 1.0);
+    
+    if(IsDiagonal())
+    {
+        // SetCovariance already applied the data relative floor, the ridge only keeps variances positive
+        _Precision.create(d, 1, CV_64F);
+        double logDet = 0;
+        for(int i = 0; i < d; i++)
+        {
+            double variance = std::max(_Covariance.at<double>(i, 0), ridge);
+            _Precision.at<double>(i, 0) = 1.0 / variance;
+            logDet += std::log(variance);
+        }
+        
+        _Cholesky.release();
+        _LogNormalizer = -0.5 * (d * std::log(2.0 * M_PI) + logDet);
+        return;
+    }
+    
+    cv::Mat covariance = _Covariance;
+    while(!Cholesky(covariance, _Cholesky))
+    {
+        covariance = _Covariance + ridge * cv::Mat::eye(d, d, CV_64F);
+        ridge *= 10;
+    }
     
+    // log|Sigma| = 2 * sum(log(L_ii))
+    double logDet = 0;
+    for(int i = 0; i < d; i++)
+        logDet += std::log(_Cholesky.at<double>(i, i));
+    logDet *= 2;
+    
+    cv::invert(covariance, _Precision, cv::DECOMP_CHOLESKY);
+    _LogNormalizer = -0.5 * (d * std::log(2.0 * M_PI) + logDet);
 }
 
-// Evaluates the weighted multivariate gaussian for a sample point
-double WeightedGaussian::operator ()(const cv::Mat &x) const
-{    
-    cv::Mat precision = _Covariance.inv();    
-    double outer = std::sqrt(cv::determinant(precision) / 2.0 * M_PI);
+// Log of the (unweighted) multivariate gaussian density for a sample point
+double WeightedGaussian::LogDensity(const cv::Mat &x) const
+{
+    cv::Mat meanDist = x - _Mean;
     
-    cv::Mat meanDist = x - _Mean;    
-    cv::Mat symmetricProduct = meanDist.t() * precision * meanDist; // This is a "1x1" matrix e.g. a scalar value
-    double inner = symmetricProduct.at<double>(0,0) / -2.0;
+    if(IsDiagonal())
+        return _LogNormalizer - meanDist.mul(meanDist).dot(_Precision) / 2.0;
     
-    return _Weight * outer * std::exp(inner);
+    cv::Mat symmetricProduct = meanDist.t() * _Precision * meanDist; // This is a "1x1" matrix e.g. a scalar value
+    
+    return _LogNormalizer - symmetricProduct.at<double>(0,0) / 2.0;
 }
 
-GMM::GMM(int num, double convergenceThreshold)
-    : _Gaussians(num), _ConvergenceThreshold(convergenceThreshold)
+// Evaluates the weighted multivariate gaussian for a sample point
+double WeightedGaussian::operator ()(const cv::Mat &x) const
+{
+    return _Weight * std::exp(LogDensity(x));
+}
+
+GMM::GMM(int num, double convergenceThreshold, CovarianceType covarianceType)
+    : _Gaussians(num), _ConvergenceThreshold(convergenceThreshold), _CovarianceType(covarianceType), _OnlineSteps(0)
 {
     
 }
@@ -40,11 +209,12 @@ std::vector<double> GMM::Supervector(const BagOfFeatures &bof)
     cv::Mat samples(bof[0].size(), bof.size(), CV_64F); // Each column in this matrix is a sample
     for(int i = 0; i < bof.size(); i++)
     {
-        samples.col(i) = cv::Mat(bof[i]);
+        cv::Mat(bof[i]).copyTo(samples.col(i));
     }
     
     // Compute gamma for the input samples
-    cv::Mat gamma = _E(samples);
+    double logLikelihood;
+    cv::Mat gamma = _E(samples, logLikelihood);
     
     // Compute Z vectors
     cv::Mat Z = cv::Mat::zeros(samples.rows, _Gaussians.size(), CV_64F);
@@ -79,17 +249,21 @@ std::vector<double> GMM::Supervector(const BagOfFeatures &bof)
 }
 
 // Trains a GMM on feature data from a set of images using the Expecation Maximization (EM) algorithm
-// This is probably pretty slow
+// This is probably pretty slow, Update refreshes a trained model from new data instead
 void GMM::Train(const FeatureSet &featureSet, int maxIterations)
 {
     // Make one long vector out of the input features
+    size_t featureCount = 0;
+    for(const BagOfFeatures &singleImg : featureSet)
+    {
+        featureCount += singleImg.size();
+    }
+    
     BagOfFeatures featuresFlattened;
-    for(BagOfFeatures singleImg : featureSet)
+    featuresFlattened.reserve(featureCount);
+    for(const BagOfFeatures &singleImg : featureSet)
     {
-        for(Histogram h : singleImg)
-        {
-            featuresFlattened.push_back(h);
-        }
+        featuresFlattened.insert(featuresFlattened.end(), singleImg.begin(), singleImg.end());
     }
     
     // Initialize using k-means
@@ -99,20 +273,204 @@ void GMM::Train(const FeatureSet &featureSet, int maxIterations)
     cv::Mat allFeatures(featuresFlattened[0].size(), featuresFlattened.size(), CV_64F); // Each column in this matrix is a sample
     for(int i = 0; i < featuresFlattened.size(); i++)
     {
-        allFeatures.col(i) = cv::Mat(featuresFlattened[i]);
+        cv::Mat(featuresFlattened[i]).copyTo(allFeatures.col(i));
     }
     
-    // Make some initialization using k-means
-    double llikelihood = _LogLikelihood(allFeatures);
+    // The E step also yields the log likelihood of the current model, so each iteration evaluates the gaussians once
+    GMMStatistics stats = _ParallelAccumulate(allFeatures);
+    double llikelihood = stats.LogLikelihood;
     
     for(int i = 0; i < maxIterations; i++)
-    {       
-        cv::Mat gamma = _E(allFeatures);
-        _M(gamma, allFeatures);
+    {
+        Maximize(stats);
+        
+        double previous = llikelihood;
+        stats = _ParallelAccumulate(allFeatures);
+        llikelihood = stats.LogLikelihood;
         
-        if((_LogLikelihood(allFeatures) - llikelihood) <= _ConvergenceThreshold)
+        if((llikelihood - previous) <= _ConvergenceThreshold)
             break;
     }
+    
+    // A batch trained model starts a fresh online schedule
+    _Running = GMMStatistics();
+    _OnlineSteps = 0;
+}
+
+// Stepwise EM (Cappe & Moulines, Liang & Klein)
+//   s <- (1 - eta) s + eta * s_batch / |batch|,  eta = (t + 2)^-stepExponent
+// with s the per sample sufficient statistics, so the cost is proportional to the batch and not to the corpus
+bool GMM::Update(const cv::Mat &batch, double stepExponent)
+{
+    // An empty batch carries no statistics, the step would divide by zero
+    if(batch.cols == 0)
+        return false;
+    
+    // A model that was never trained is initialized from the first batch, k-means needs a sample per gaussian
+    if(_Gaussians.empty() || _Gaussians[0].Mean().empty())
+    {
+        if(NumGaussians() == 0 || batch.cols < NumGaussians())
+        {
+            std::cout << "GMM: can't initialize " << NumGaussians() << " gaussians from a batch of " << batch.cols << " samples" << std::endl;
+            return false;
+        }
+        
+        BagOfFeatures bof;
+        for(int n = 0; n < batch.cols; n++)
+        {
+            bof.push_back(Histogram(batch.col(n).begin<double>(), batch.col(n).end<double>()));
+        }
+        _Init(bof);
+        _Running = GMMStatistics();
+    }
+    else if(batch.rows != _Gaussians[0].Mean().rows)
+    {
+        std::cout << "GMM: batch of " << batch.rows << " dimensional samples doesn't fit the " << _Gaussians[0].Mean().rows << " dimensional model" << std::endl;
+        return false;
+    }
+    
+    if(_Running.N.empty())
+        _InitRunning();
+    
+    GMMStatistics stats = _ParallelAccumulate(batch);
+    double eta = std::pow(_OnlineSteps + 2.0, -stepExponent);
+    double scale = eta / stats.Count;
+    
+    // The running statistics only change when the M step accepts them
+    GMMStatistics running = _Running;
+    running.N = (1 - eta) * _Running.N + scale * stats.N;
+    running.X = (1 - eta) * _Running.X + scale * stats.X;
+    running.XX = (1 - eta) * _Running.XX + scale * stats.XX;
+    running.LogLikelihood = stats.LogLikelihood / stats.Count;
+    
+    if(!Maximize(running))
+        return false;
+    _Running = running;
+    _OnlineSteps++;
+    return true;
+}
+
+// Per sample statistics implied by the current parameters: Nk = w, X = w u, XX = w (Sigma + u u^T)
+// This is what lets online updates resume from a saved model
+void GMM::_InitRunning(void)
+{
+    int K = _Gaussians.size();
+    int d = _Gaussians[0].Mean().rows;
+    _Running = GMMStatistics(K, d, _CovarianceType);
+    _Running.Count = 1;
+    
+    for(int k = 0; k < K; k++)
+    {
+        const WeightedGaussian &g = _Gaussians[k];
+        double w = g.Weight();
+        _Running.N.at<double>(k, 0) = w;
+        
+        cv::Mat Xk = _Running.X.col(k);
+        cv::Mat(w * g.Mean()).copyTo(Xk);
+        
+        if(_CovarianceType == DiagonalCovariance)
+        {
+            cv::Mat XXk = _Running.XX.col(k);
+            cv::Mat(w * (g.Covariance() + g.Mean().mul(g.Mean()))).copyTo(XXk);
+        }
+        else
+        {
+            cv::Mat XXk = _Running.XX.rowRange(k * d, (k + 1) * d);
+            cv::Mat(w * (g.Covariance() + g.Mean() * g.Mean().t())).copyTo(XXk);
+        }
+    }
+}
+
+bool GMM::Save(const std::string &filename) const
+{
+    ModelHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.Magic, modelMagic, sizeof(modelMagic));
+    header.Version = modelVersion;
+    header.CovarianceType = _CovarianceType;
+    header.NumGaussians = _Gaussians.size();
+    header.Dimension = _Gaussians.empty() ? 0 : _Gaussians[0].Mean().rows;
+    header.OnlineSteps = _OnlineSteps;
+    
+    std::ofstream fileout(filename, std::ios::binary);
+    fileout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    for(const WeightedGaussian &g : _Gaussians)
+        fileout.write(reinterpret_cast<const char*>(&g._Weight), sizeof(double));
+    for(const WeightedGaussian &g : _Gaussians)
+        fileout.write(reinterpret_cast<const char*>(&g._LogNormalizer), sizeof(double));
+    for(const WeightedGaussian &g : _Gaussians)
+        WriteMat(fileout, g._Mean);
+    for(const WeightedGaussian &g : _Gaussians)
+        WriteMat(fileout, g._Covariance);
+    for(const WeightedGaussian &g : _Gaussians)
+        WriteMat(fileout, g._Precision);
+    
+    return fileout.good();
+}
+
+GMM GMM::Clone(void) const
+{
+    GMM copy(*this);
+    for(WeightedGaussian &g : copy._Gaussians)
+    {
+        g._Mean = g._Mean.clone();
+        g._Covariance = g._Covariance.clone();
+        g._Cholesky = g._Cholesky.clone();
+        g._Precision = g._Precision.clone();
+    }
+    copy._Running.N = _Running.N.clone();
+    copy._Running.X = _Running.X.clone();
+    copy._Running.XX = _Running.XX.clone();
+    
+    // Nothing of the copy points into the mapped file any more
+    copy._Storage = MappedFile();
+    return copy;
+}
+
+// No parsing: after checking the header the gaussians are matrix headers over the mapped file
+// The mapping is private, so a loaded model can still be retrained without writing to the file
+bool GMM::Load(const std::string &filename)
+{
+    MappedFile storage;
+    if(!storage.open(filename) || storage.size() < sizeof(ModelHeader))
+        return false;
+    
+    const ModelHeader *header = reinterpret_cast<const ModelHeader*>(storage.data());
+    if(std::memcmp(header->Magic, modelMagic, sizeof(modelMagic)) != 0 || header->Version != modelVersion
+       || !ValidCovarianceType(header->CovarianceType) || header->NumGaussians < 0 || header->Dimension < 0)
+        return false;
+    
+    int K = header->NumGaussians;
+    int d = header->Dimension;
+    CovarianceType type = (CovarianceType)header->CovarianceType;
+    int covarianceCols = type == DiagonalCovariance ? 1 : d;
+    size_t covarianceSize = (size_t)d * covarianceCols;
+    if(storage.size() != sizeof(ModelHeader) + sizeof(double) * (2 * K + (size_t)K * d + 2 * K * covarianceSize))
+        return false;
+    
+    double *weights = reinterpret_cast<double*>(storage.data() + sizeof(ModelHeader));
+    double *logNormalizers = weights + K;
+    double *means = logNormalizers + K;
+    double *covariances = means + (size_t)K * d;
+    double *precisions = covariances + K * covarianceSize;
+    
+    _Gaussians.assign(K, WeightedGaussian());
+    for(int k = 0; k < K; k++)
+    {
+        WeightedGaussian &g = _Gaussians[k];
+        g._Weight = weights[k];
+        g._LogNormalizer = logNormalizers[k];
+        g._Mean = cv::Mat(d, 1, CV_64F, means + (size_t)k * d);
+        g._Covariance = cv::Mat(d, covarianceCols, CV_64F, covariances + k * covarianceSize);
+        g._Precision = cv::Mat(d, covarianceCols, CV_64F, precisions + k * covarianceSize);
+    }
+    
+    _CovarianceType = type;
+    _Storage = storage;
+    _Running = GMMStatistics();
+    _OnlineSteps = header->OnlineSteps;
+    return true;
 }
 
 // Initialzes the GMM using k-means
@@ -123,27 +481,42 @@ void GMM::_Init(BagOfFeatures &bof)
     std::vector<int> sizes, labels;    
     kmeans(bof, _Gaussians.size(), labels, u0, sizes, 15, 50);
     
+    int d = bof[0].size();
+    cv::Mat sum = cv::Mat::zeros(d, 1, CV_64F), sumSquares = cv::Mat::zeros(d, 1, CV_64F);
+    for(const std::vector<double> &x : bof)
+    {
+        for(int i = 0; i < d; i++)
+        {
+            sum.at<double>(i, 0) += x[i];
+            sumSquares.at<double>(i, 0) += x[i] * x[i];
+        }
+    }
+    cv::Mat varianceFloor = VarianceFloor(sum, sumSquares, bof.size());
+    
     // For each gaussian
     for(int k = 0; k < _Gaussians.size(); k++)
     {
         // The initial weight is the number of samples assigned to the kth mean over the total number of samples
-        _Gaussians[k].Weight() = sizes[k] / bof.size();
+        _Gaussians[k].Weight() = sizes[k] / double(bof.size());
         
         // The inital mean is just the kth mean
-        _Gaussians[k].Mean() = cv::Mat(u0[k]);
+        _Gaussians[k].Mean() = cv::Mat(u0[k], true);
         
         // The covarance is computed from the mean distance for each sample in the cluster 
-        cv::Mat c0 = cv::Mat::zeros(u0[k].size(), u0[k].size(), CV_64F);
+        cv::Mat c0 = cv::Mat::zeros(u0[k].size(), _CovarianceType == DiagonalCovariance ? 1 : u0[k].size(), CV_64F);
         for(auto labeln = std::find(labels.begin(), labels.end(), k); labeln != labels.end(); labeln = std::find(labeln+1, labels.end(), k))
         {
             int n = std::distance(labels.begin(), labeln);
             cv::Mat meanDist = cv::Mat(bof[n]) - _Gaussians[k].Mean();
-            c0 += (meanDist * meanDist.t());
+            if(_CovarianceType == DiagonalCovariance)
+                c0 += meanDist.mul(meanDist);
+            else
+                c0 += (meanDist * meanDist.t());
         };
         
         c0 /= sizes[k]; // This needs to be normalized (in a sense)
         
-        _Gaussians[k].Covariance() = c0;        
+        _Gaussians[k].SetCovariance(c0, varianceFloor);
     }    
 }
 
@@ -151,87 +524,303 @@ void GMM::_Init(BagOfFeatures &bof)
 // Posterior probability that x belongs to the kth gaussian found using bayes theorem
 double GMM::_Responsibility(const cv::Mat &x, int k) const
 {
-    const GMM &model = *this;
-    return _Gaussians[k](x) / model(x);
+    double logLikelihood;
+    cv::Mat gamma = _E(x, logLikelihood);
+    return gamma.at<double>(0, k);
+}
+
+// Log of the weighted density of every gaussian for every sample (column), returns a KxN matrix
+// The whole block is evaluated with matrix products instead of one sample at a time
+cv::Mat GMM::_LogWeighted(const cv::Mat &samples) const
+{
+    int K = _Gaussians.size();
+    int d = samples.rows;
+    cv::Mat logp(K, samples.cols, CV_64F);
+    
+    if(_CovarianceType == DiagonalCovariance)
+    {
+        // log N(x) = c_k - 1/2 sum(x^2 / s^2) + sum(x u / s^2), so the block is two products against the sample matrix
+        cv::Mat A(K, d, CV_64F), B(K, d, CV_64F);
+        std::vector<double> c(K);
+        for(int k = 0; k < K; k++)
+        {
+            const WeightedGaussian &g = _Gaussians[k];
+            cv::Mat scaledMean = g.Mean().mul(g.Precision());
+            cv::Mat(g.Precision().t()).copyTo(A.row(k));
+            cv::Mat(scaledMean.t()).copyTo(B.row(k));
+            c[k] = std::log(g.Weight()) + g.LogNormalizer() - 0.5 * g.Mean().dot(scaledMean);
+        }
+        
+        cv::Mat squared = samples.mul(samples);
+        cv::gemm(A, squared, -0.5, cv::Mat(), 0, logp);
+        cv::gemm(B, samples, 1.0, logp, 1.0, logp);
+        for(int k = 0; k < K; k++)
+        {
+            cv::Mat row = logp.row(k);
+            row += cv::Scalar(c[k]);
+        }
+    }
+    else
+    {
+        for(int k = 0; k < K; k++)
+        {
+            const WeightedGaussian &g = _Gaussians[k];
+            cv::Mat meanDist = samples - cv::repeat(g.Mean(), 1, samples.cols);
+            cv::Mat mahalanobis;
+            cv::reduce(meanDist.mul(g.Precision() * meanDist), mahalanobis, 0, CV_REDUCE_SUM);
+            
+            cv::Mat row = logp.row(k);
+            mahalanobis.convertTo(row, CV_64F, -0.5, std::log(g.Weight()) + g.LogNormalizer());
+        }
+    }
+    
+    return logp;
+}
+
+cv::Mat GMM::Responsibilities(const cv::Mat &samples) const
+{
+    double logLikelihood;
+    return _E(samples, logLikelihood);
 }
 
 // E - step
 // Computes the responsibility of each gaussian for each data sample
 // returns an nxk matrix (the gamma matrix) where n is the number of features and k is the number of gaussians
-cv::Mat GMM::_E(const cv::Mat &samples) const
+// Works in the log domain (log-sum-exp) since 128-d densities underflow, and sums log p(x) into logLikelihood
+cv::Mat GMM::_E(const cv::Mat &samples, double &logLikelihood) const
+{
+    int K = _Gaussians.size();
+    cv::Mat gamma(samples.cols, K, CV_64F);
+    logLikelihood = 0;
+    
+    for(int start = 0; start < samples.cols; start += blockSize)
+    {
+        int end = std::min(start + blockSize, samples.cols);
+        cv::Mat logp = _LogWeighted(samples.colRange(start, end));
+        
+        // log p(x) = max + log(sum(exp(log p_k(x) - max))) for each sample
+        cv::Mat maxLog, sum;
+        cv::reduce(logp, maxLog, 0, CV_REDUCE_MAX);
+        cv::Mat shifted = logp - cv::repeat(maxLog, K, 1);
+        cv::exp(shifted, shifted);
+        cv::reduce(shifted, sum, 0, CV_REDUCE_SUM);
+        cv::log(sum, sum);
+        cv::Mat logGmm = maxLog + sum; // GMM in its current state evaluated for each sample
+        
+        // Responsibilities are exp(log p_k(x) - log p(x)), stored one sample per row
+        cv::Mat responsibilities = logp - cv::repeat(logGmm, K, 1);
+        cv::exp(responsibilities, responsibilities);
+        cv::Mat block = gamma.rowRange(start, end);
+        cv::transpose(responsibilities, block);
+        
+        logLikelihood += cv::sum(logGmm)[0];
+    }
+    
+    return gamma;
+}
+
+// Accumulates the sufficient statistics of the samples block by block
+// Nk and the first order sums are one product each against the responsibilities, no per-sample temporaries
+void GMM::Accumulate(const cv::Mat &samples, GMMStatistics &stats) const
 {
-    const GMM &model = *this;
-    cv::Mat gamma(samples.cols, _Gaussians.size(), CV_64F);
+    int K = _Gaussians.size();
+    int d = samples.rows;
     
-    for(int n = 0; n < samples.cols; n++) // For each sample
+    for(int start = 0; start < samples.cols; start += blockSize)
     {
-        double gmmXn = model(samples.col(n)); // GMM in its current state evaluated for this sample
+        int end = std::min(start + blockSize, samples.cols);
+        cv::Mat block = samples.colRange(start, end);
+        
+        double logLikelihood;
+        cv::Mat gamma = _E(block, logLikelihood); // n x K
+        stats.LogLikelihood += logLikelihood;
+        stats.Count += block.cols;
         
-        for(int k = 0; k < _Gaussians.size(); k++) // and each gaussian
+        cv::Mat Nk;
+        cv::reduce(gamma, Nk, 0, CV_REDUCE_SUM);
+        stats.N += Nk.t();
+        cv::gemm(block, gamma, 1.0, stats.X, 1.0, stats.X);
+        
+        if(stats.Type == DiagonalCovariance)
+        {
+            cv::gemm(block.mul(block), gamma, 1.0, stats.XX, 1.0, stats.XX);
+        }
+        else
         {
-            gamma.at<double>(n, k) = _Gaussians[k](samples.col(n)) / gmmXn; // Find its responsibility
+            for(int k = 0; k < K; k++)
+            {
+                cv::Mat weighted = block.mul(cv::repeat(gamma.col(k).t(), d, 1));
+                cv::Mat XXk = stats.XX.rowRange(k * d, (k + 1) * d);
+                cv::gemm(weighted, block, 1.0, XXk, 1.0, XXk, cv::GEMM_2_T);
+            }
         }
     }
+}
+
+// Splits the samples into one contiguous shard per thread, then reduces the shards in order
+// so the result does not depend on thread scheduling
+GMMStatistics GMM::_ParallelAccumulate(const cv::Mat &samples) const
+{
+    int shards = 1;
+#ifdef _OPENMP
+    shards = std::max(1, std::min(omp_get_max_threads(), samples.cols / blockSize + 1));
+#endif
     
-    return gamma;
+    std::vector<GMMStatistics> partial;
+    for(int s = 0; s < shards; s++)
+    {
+        partial.push_back(GMMStatistics(_Gaussians.size(), samples.rows, _CovarianceType));
+    }
+    
+    #pragma omp parallel for schedule(static)
+    for(int s = 0; s < shards; s++)
+    {
+        int begin = (long long)samples.cols * s / shards;
+        int end = (long long)samples.cols * (s + 1) / shards;
+        Accumulate(samples.colRange(begin, end), partial[s]);
+    }
+    
+    for(int s = 1; s < shards; s++)
+    {
+        partial[0].Add(partial[s]);
+    }
+    
+    return partial[0];
 }
 
 // M - step
-// Improves the mean, covariance, and weight of each gaussian using
-// the responsibilites computed in the E step
-void GMM::_M(const cv::Mat &gamma, const cv::Mat &samples)
+// Improves the mean, covariance, and weight of each gaussian from the
+// sufficient statistics gathered with the responsibilites of the E step
+bool GMM::Maximize(const GMMStatistics &stats)
 {
+    int d = stats.X.rows;
+    if(stats.Type != _CovarianceType || stats.NumGaussians() != NumGaussians() || (!_Gaussians.empty() && d != _Gaussians[0].Mean().rows))
+    {
+        std::cout << "GMM: statistics of " << stats.NumGaussians() << " gaussians in " << d << " dimensions don't fit the model" << std::endl;
+        return false;
+    }
+    
+    // The statistics summed over all gaussians are those of the data itself
+    cv::Mat sum, sumSquares;
+    cv::reduce(stats.X, sum, 1, CV_REDUCE_SUM);
+    if(_CovarianceType == DiagonalCovariance)
+        cv::reduce(stats.XX, sumSquares, 1, CV_REDUCE_SUM);
+    else
+    {
+        sumSquares = cv::Mat::zeros(d, 1, CV_64F);
+        for(int k = 0; k < _Gaussians.size(); k++)
+            sumSquares += stats.XX.rowRange(k * d, (k + 1) * d).diag();
+    }
+    cv::Mat varianceFloor = VarianceFloor(sum, sumSquares, stats.Count);
+    
     for(int k = 0; k < _Gaussians.size(); k++)
     {
-        // Get the kth gaussian responsibilities
-        cv::Mat gammak = gamma.col(k);
-        
-        // Compute Nk, the sum of all responsibilties for this gaussian
-        double Nk = cv::sum(gammak)[0];
+        // Nk, the sum of all responsibilties for this gaussian
+        double Nk = stats.N.at<double>(k, 0);
         
-        // Update the mean
-        cv::Mat uNew = cv::Mat::zeros(gammak.cols, 1, CV_64F);
-        for(int n = 0; n < gammak.rows; n++)
+        // A gaussian nobody is responsible for drops out instead of dividing by zero
+        if(Nk <= 0)
         {
-            uNew += gammak.at<double>(n, 1) * samples.col(n);
+            _Gaussians[k].Weight() = 0;
+            continue;
         }
         
-        uNew /= Nk;
+        // Update the mean
+        cv::Mat uNew = stats.X.col(k) / Nk;
         _Gaussians[k].Mean() = uNew;
         
-        // Update the covariance
-        cv::Mat sigmaNew = cv::Mat::zeros(gammak.rows, gammak.rows, CV_64F);
-        for(int n = 0; n < gammak.rows; n++)
-        {
-            cv::Mat meanDistance = samples.col(n) - uNew;
-            sigmaNew += gammak.at<double>(n, 1) * (meanDistance * meanDistance.t());
-        }
+        // Update the covariance, E[xx^T] - uu^T
+        cv::Mat sigmaNew;
+        if(_CovarianceType == DiagonalCovariance)
+            sigmaNew = stats.XX.col(k) / Nk - uNew.mul(uNew);
+        else
+            sigmaNew = stats.XX.rowRange(k * d, (k + 1) * d) / Nk - uNew * uNew.t();
         
-        sigmaNew /= Nk;
-        _Gaussians[k].Covariance() = sigmaNew;
+        _Gaussians[k].SetCovariance(sigmaNew, varianceFloor); // The only place the cached precision is refreshed during training
         
         // Udpate weight
-        _Gaussians[k].Weight() = Nk / samples.cols;
+        _Gaussians[k].Weight() = Nk / stats.Count;
     }
+    return true;
 }
 
-// Computes the likelihood that the GMM that is currently trained
-// is the one that generated our data
-double GMM::_LogLikelihood(const cv::Mat &samples) const
-{    
-    const GMM &gmm = *this;
+GMMStatistics::GMMStatistics(void)
+    : Type(FullCovariance), Count(0), LogLikelihood(0)
+{
     
-    double ll = 0;
-    for(int n = 0; n < samples.cols; n++)
+}
+
+GMMStatistics::GMMStatistics(int numGaussians, int dimension, CovarianceType covarianceType)
+    : Type(covarianceType), Count(0), LogLikelihood(0),
+      N(cv::Mat::zeros(numGaussians, 1, CV_64F)),
+      X(cv::Mat::zeros(dimension, numGaussians, CV_64F))
+{
+    if(Type == DiagonalCovariance)
+        XX = cv::Mat::zeros(dimension, numGaussians, CV_64F);
+    else
+        XX = cv::Mat::zeros(numGaussians * dimension, dimension, CV_64F);
+}
+
+bool GMMStatistics::Add(const GMMStatistics &other)
+{
+    if(other.Type != Type || other.NumGaussians() != NumGaussians() || other.Dimension() != Dimension())
     {
-        ll += std::log(gmm(samples.col(n)));
+        std::cout << "GMMStatistics: can't add statistics of " << other.NumGaussians() << " gaussians in " << other.Dimension()
+                  << " dimensions to statistics of " << NumGaussians() << " in " << Dimension() << std::endl;
+        return false;
     }
     
-    return ll;
+    Count += other.Count;
+    LogLikelihood += other.LogLikelihood;
+    N += other.N;
+    X += other.X;
+    XX += other.XX;
+    return true;
+}
+
+bool GMMStatistics::Save(const std::string &filename) const
+{
+    StatisticsHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.Magic, statisticsMagic, sizeof(statisticsMagic));
+    header.Version = statisticsVersion;
+    header.CovarianceType = Type;
+    header.NumGaussians = NumGaussians();
+    header.Dimension = Dimension();
+    
+    std::ofstream fileout(filename, std::ios::binary);
+    fileout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fileout.write(reinterpret_cast<const char*>(&Count), sizeof(Count));
+    fileout.write(reinterpret_cast<const char*>(&LogLikelihood), sizeof(LogLikelihood));
+    for(const cv::Mat *m : { &N, &X, &XX })
+    {
+        cv::Mat continuous = m->clone();
+        fileout.write(reinterpret_cast<const char*>(continuous.data), continuous.total() * sizeof(double));
+    }
+    return fileout.good();
+}
+
+bool GMMStatistics::Load(const std::string &filename)
+{
+    std::ifstream filein(filename, std::ios::binary);
+    StatisticsHeader header;
+    filein.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if(!filein || std::memcmp(header.Magic, statisticsMagic, sizeof(statisticsMagic)) != 0 || header.Version != statisticsVersion
+       || !ValidCovarianceType(header.CovarianceType) || header.NumGaussians <= 0 || header.Dimension <= 0)
+        return false;
+    
+    *this = GMMStatistics(header.NumGaussians, header.Dimension, (CovarianceType)header.CovarianceType);
+    filein.read(reinterpret_cast<char*>(&Count), sizeof(Count));
+    filein.read(reinterpret_cast<char*>(&LogLikelihood), sizeof(LogLikelihood));
+    for(cv::Mat *m : { &N, &X, &XX })
+    {
+        filein.read(reinterpret_cast<char*>(m->data), m->total() * sizeof(double));
+    }
+    return filein.good();
 }
 
 // Evaluates the GMM on a sample point
 double GMM::operator ()(const cv::Mat &x) const
 {
-    return std::accumulate(_Gaussians.begin(), _Gaussians.end(), 0, [&x](double val, WeightedGaussian wg) { return val + wg(x); });
+    return std::accumulate(_Gaussians.begin(), _Gaussians.end(), 0.0, [&x](double val, const WeightedGaussian &wg) { return val + wg(x); });
 }
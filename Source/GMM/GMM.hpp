@@ -2,10 +2,15 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <numeric>
+#include <string>
 #include "../Util/Types.hpp"
+#include "../Util/MappedFile.hpp"
 
 namespace LocalDescriptorAndBagOfFeature 
 {   
+    // Full gaussians keep a DxD covariance, diagonal ones keep a Dx1 column of variances
+    enum CovarianceType { FullCovariance, DiagonalCovariance };
+    
     class WeightedGaussian
     {
         public:
@@ -13,38 +18,115 @@ namespace LocalDescriptorAndBagOfFeature
             WeightedGaussian(double weight, const cv::Mat &mean, const cv::Mat &covariance);
             
             double operator ()(const cv::Mat &x) const;
+            double LogDensity(const cv::Mat &x) const;
             
             double &Weight(void) { return _Weight; }
+            double Weight(void) const { return _Weight; }
             cv::Mat &Mean(void) { return _Mean; }
-            cv::Mat &Covariance(void) { return _Covariance; }
+            const cv::Mat &Mean(void) const { return _Mean; }
+            const cv::Mat &Covariance(void) const { return _Covariance; }
+            const cv::Mat &Precision(void) const { return _Precision; }
+            double LogNormalizer(void) const { return _LogNormalizer; }
+            
+            bool IsDiagonal(void) const { return _Covariance.cols == 1; }
+            
+            // Replaces the covariance (DxD, or Dx1 variances for a diagonal gaussian) and refreshes the cached terms derived from it
+            // Variances below varianceFloor (Dx1, when given) are raised to it so a collapsing gaussian can't dominate the likelihood
+            void SetCovariance(const cv::Mat &covariance, const cv::Mat &varianceFloor = cv::Mat());
             
         private:
+            friend class GMM; // Restores the cached terms when loading a saved model
+            
+            void _Update(void);
+            
             double _Weight;
             cv::Mat _Mean;
             cv::Mat _Covariance;
+            
+            // Cached from the covariance by _Update, so evaluation never inverts a matrix
+            // For a diagonal gaussian the precision is the Dx1 column of inverse variances
+            cv::Mat _Cholesky;
+            cv::Mat _Precision;
+            double _LogNormalizer;
+    };
+    
+    // Sufficient statistics of a set of samples under a GMM, these are additive so shards
+    // (threads or processes) can each accumulate their own and be reduced before a single M step
+    struct GMMStatistics
+    {
+        GMMStatistics(void);
+        GMMStatistics(int numGaussians, int dimension, CovarianceType covarianceType);
+        
+        // Adds nothing and returns false when other was taken with a different number of gaussians, dimension or covariance type
+        bool Add(const GMMStatistics &other);
+        
+        // Versioned binary dump, for handing statistics between processes
+        bool Save(const std::string &filename) const;
+        bool Load(const std::string &filename);
+        
+        int NumGaussians(void) const { return N.rows; }
+        int Dimension(void) const { return X.rows; }
+        
+        CovarianceType Type;
+        double Count;           // Number of samples
+        double LogLikelihood;   // Sum of log p(x) under the model the statistics were taken with
+        cv::Mat N;              // Kx1, sum of responsibilities
+        cv::Mat X;              // DxK, responsibility weighted sum of samples
+        cv::Mat XX;             // Responsibility weighted sum of x*x^T stacked as (K*D)xD, or of x.*x as DxK for diagonal
     };
     
     class GMM
     {
         public:
-            GMM(int num, double convergenceThreshold = 0.001);
+            GMM(int num, double convergenceThreshold = 0.001, CovarianceType covarianceType = FullCovariance);
             
             void Train(const FeatureSet &featureSet, int maxIterations);
             std::vector<double> Supervector(const BagOfFeatures &bof);
             
+            // Versioned binary model, loaded by memory mapping the file and pointing the gaussians into it
+            bool Save(const std::string &filename) const;
+            bool Load(const std::string &filename);
+            
+            // Deep copy, copying a GMM shares the gaussians' matrices with the original
+            GMM Clone(void) const;
+            
             int NumGaussians(void) const { return _Gaussians.size(); }
+            const WeightedGaussian &Gaussian(int k) const { return _Gaussians[k]; }
+            CovarianceType Covariance(void) const { return _CovarianceType; }
             
             double operator ()(const cv::Mat &x) const;
             
+            // Posterior of each gaussian for each sample (column), an NxK matrix
+            cv::Mat Responsibilities(const cv::Mat &samples) const;
+            
+            // E step over samples (columns), adding their sufficient statistics to stats
+            void Accumulate(const cv::Mat &samples, GMMStatistics &stats) const;
+            // M step from (reduced) sufficient statistics, returns false and leaves the model as it is when they don't fit it
+            bool Maximize(const GMMStatistics &stats);
+            
+            // Online (stepwise) EM: folds a mini-batch of samples (columns) into running statistics with step
+            // size (t + 2)^-stepExponent and re-estimates the model, works on a trained or loaded model
+            // Returns false and leaves the model as it is for an empty batch, a batch of the wrong dimension, or a
+            // first batch with fewer samples than gaussians
+            bool Update(const cv::Mat &batch, double stepExponent = 0.6);
+            int OnlineSteps(void) const { return _OnlineSteps; }
+            
         private:                     
             void _Init(BagOfFeatures &bof);
+            void _InitRunning(void);
             
             double _Responsibility(const cv::Mat &x, int k) const;
-            cv::Mat _E(const cv::Mat &features) const;
-            void _M(const cv::Mat &gamma, const cv::Mat &samples);
-            double _LogLikelihood(const cv::Mat &samples) const;
+            cv::Mat _LogWeighted(const cv::Mat &samples) const;
+            cv::Mat _E(const cv::Mat &features, double &logLikelihood) const;
+            GMMStatistics _ParallelAccumulate(const cv::Mat &samples) const;
             
             std::vector<WeightedGaussian> _Gaussians;
             double _ConvergenceThreshold;
+            CovarianceType _CovarianceType;
+            MappedFile _Storage; // Backs the gaussians of a loaded model
+            
+            // Per sample statistics of the online updates, rebuilt from the parameters when empty
+            GMMStatistics _Running;
+            int _OnlineSteps;
     };
 }
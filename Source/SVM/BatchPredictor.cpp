@@ -0,0 +1,220 @@
+#include "BatchPredictor.hpp"
+#include "KernelOps.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    //samples of a block against every SV for the additive kernels, the block stays in cache while the SVs stream past
+    template <class Op> void fill_block(const double *x, int rows, const double *sv, int l, int dim, int stride, double *kernel){
+        for(int j = 0; j < l; j++){
+            const double *s = sv + (size_t)j * stride;
+            for(int i = 0; i < rows; i++){
+                kernel[(size_t)i * l + j] = additive<Op>(x + (size_t)i * stride, s, dim);
+            }
+        }
+    }
+}
+
+BatchPredictor::BatchPredictor(const svm_model *model, int block_size)
+    : param(model->param), nr_class(model->nr_class), l(model->l), dim(0), block_size(block_size)
+{
+    if(param.kernel_type == PRECOMPUTED){
+        std::cout << "BatchPredictor does not support precomputed kernels" << std::endl;
+    }
+
+    bool one_function = param.svm_type == ONE_CLASS || param.svm_type == EPSILON_SVR || param.svm_type == NU_SVR;
+    num_functions = one_function ? 1 : nr_class * (nr_class - 1) / 2;
+    rho.assign(model->rho, model->rho + num_functions);
+
+    for(int i = 0; i < l && param.kernel_type != PRECOMPUTED; i++){
+        const svm_node *p = model->SV[i];
+        if(p->index == SVM_DENSE_ROW){
+            dim = std::max(dim, (int)p->value);
+        } else {
+            for(; p->index != -1; ++p){
+                dim = std::max(dim, p->index);
+            }
+        }
+    }
+    //rows padded to 32 bytes
+    stride = (dim + 3) / 4 * 4;
+
+    sv.assign((size_t)l * stride, 0.0);
+    sv_norm.resize(l);
+    for(int i = 0; i < l && param.kernel_type != PRECOMPUTED; i++){
+        double *row = &sv[(size_t)i * stride];
+        const svm_node *p = model->SV[i];
+        if(p->index == SVM_DENSE_ROW){
+            const double *v = svm_dense_values(const_cast<svm_node *>(p));
+            std::copy(v, v + (int)p->value, row);
+        } else {
+            for(; p->index != -1; ++p){
+                row[p->index - 1] = p->value;
+            }
+        }
+        sv_norm[i] = additive<product_op>(row, row, dim);
+    }
+
+    //coefficients of pair (i,j) in the order of the SVs of class i then class j
+    if(one_function){
+        coefficients.push_back(std::vector<double>(model->sv_coef[0], model->sv_coef[0] + l));
+    } else {
+        labels.assign(model->label, model->label + nr_class);
+        count.assign(model->nSV, model->nSV + nr_class);
+        start.assign(nr_class, 0);
+        for(int i = 1; i < nr_class; i++){
+            start[i] = start[i-1] + count[i-1];
+        }
+        for(int i = 0; i < nr_class; i++){
+            for(int j = i + 1; j < nr_class; j++){
+                std::vector<double> coef(model->sv_coef[j-1] + start[i], model->sv_coef[j-1] + start[i] + count[i]);
+                coef.insert(coef.end(), model->sv_coef[i] + start[j], model->sv_coef[i] + start[j] + count[j]);
+                coefficients.push_back(coef);
+            }
+        }
+    }
+}
+
+void BatchPredictor::kernel_block(const double *x, const double *norm, int rows, double *kernel) const {
+    switch(param.kernel_type){
+        case INTERSECTION:
+            fill_block<min_op>(x, rows, sv.data(), l, dim, stride, kernel);
+            return;
+        case CHI_SQUARED:
+            fill_block<chi_squared_op>(x, rows, sv.data(), l, dim, stride, kernel);
+            return;
+        default:
+            break;
+    }
+
+    //the dot products of the other kernels are one block x SV product, the zero padding adds nothing
+    cv::Mat block(rows, stride, CV_64F, const_cast<double *>(x));
+    cv::Mat svs(l, stride, CV_64F, const_cast<double *>(sv.data()));
+    cv::Mat product(rows, l, CV_64F, kernel);
+    cv::gemm(block, svs, 1, cv::Mat(), 0, product, cv::GEMM_2_T);
+    if(product.ptr<double>() != kernel){
+        //gemm reallocated instead of writing through the header
+        cv::Mat out(rows, l, CV_64F, kernel);
+        product.copyTo(out);
+    }
+
+    for(int i = 0; i < rows; i++){
+        double *k = kernel + (size_t)i * l;
+        switch(param.kernel_type){
+            case POLY:
+                for(int j = 0; j < l; j++){
+                    k[j] = std::pow(param.gamma * k[j] + param.coef0, param.degree);
+                }
+                break;
+            case RBF:
+                for(int j = 0; j < l; j++){
+                    k[j] = std::exp(-param.gamma * std::max(norm[i] + sv_norm[j] - 2 * k[j], 0.0));
+                }
+                break;
+            case SIGMOID:
+                for(int j = 0; j < l; j++){
+                    k[j] = std::tanh(param.gamma * k[j] + param.coef0);
+                }
+                break;
+        }
+    }
+}
+
+double BatchPredictor::decide(const double *kernel, double *dec, int *vote) const {
+    if(param.svm_type == ONE_CLASS || param.svm_type == EPSILON_SVR || param.svm_type == NU_SVR){
+        dec[0] = additive<product_op>(coefficients[0].data(), kernel, l) - rho[0];
+        if(param.svm_type == ONE_CLASS){
+            return dec[0] > 0 ? 1 : -1;
+        }
+        return dec[0];
+    }
+
+    std::fill(vote, vote + nr_class, 0);
+    int p = 0;
+    for(int i = 0; i < nr_class; i++){
+        for(int j = i + 1; j < nr_class; j++, p++){
+            const double *coef = coefficients[p].data();
+            double sum = additive<product_op>(coef, kernel + start[i], count[i]);
+            sum += additive<product_op>(coef + count[i], kernel + start[j], count[j]);
+            dec[p] = sum - rho[p];
+            if(dec[p] > 0){
+                ++vote[i];
+            } else {
+                ++vote[j];
+            }
+        }
+    }
+
+    int best = 0;
+    for(int i = 1; i < nr_class; i++){
+        if(vote[i] > vote[best]){
+            best = i;
+        }
+    }
+    return labels[best];
+}
+
+bool BatchPredictor::predict_batch(const cv::Mat &samples, double *out_labels, double *dec_values) const {
+    assert(samples.type() == CV_32F || samples.type() == CV_64F);
+    if(param.kernel_type == PRECOMPUTED){
+        std::cout << "BatchPredictor can't predict with a precomputed kernel" << std::endl;
+        return false;
+    }
+
+    int blocks = (samples.rows + block_size - 1) / block_size;
+    int n = std::min(samples.cols, dim);
+
+    //each thread of this call's team allocates its own scratch, so concurrent and nested calls don't share any
+#pragma omp parallel
+    {
+    scratch s;
+    s.x.resize((size_t)block_size * stride);
+    s.norm.resize(block_size);
+    s.kernel.resize((size_t)block_size * l);
+    s.dec.resize((size_t)block_size * num_functions);
+    s.vote.resize(nr_class);
+
+#pragma omp for schedule(dynamic)
+    for(int b = 0; b < blocks; b++){
+        int first = b * block_size, rows = std::min(block_size, samples.rows - first);
+
+        //the block as doubles in the SV layout, bins past the SVs' dimension never meet a non-zero
+        //but still count towards the squared norm RBF needs, so that is taken over the whole row
+        for(int i = 0; i < rows; i++){
+            double *x = &s.x[(size_t)i * stride];
+            double tail = 0;
+            if(samples.type() == CV_32F){
+                const float *row = samples.ptr<float>(first + i);
+                std::copy(row, row + n, x);
+                for(int j = n; j < samples.cols; j++){
+                    tail += (double)row[j] * row[j];
+                }
+            } else {
+                const double *row = samples.ptr<double>(first + i);
+                std::copy(row, row + n, x);
+                for(int j = n; j < samples.cols; j++){
+                    tail += row[j] * row[j];
+                }
+            }
+            std::fill(x + n, x + stride, 0.0);
+            s.norm[i] = param.kernel_type == RBF ? additive<product_op>(x, x, dim) + tail : 0;
+        }
+
+        kernel_block(s.x.data(), s.norm.data(), rows, s.kernel.data());
+        for(int i = 0; i < rows; i++){
+            double *dec = dec_values ? dec_values + (size_t)(first + i) * num_functions : &s.dec[(size_t)i * num_functions];
+            out_labels[first + i] = decide(&s.kernel[(size_t)i * l], dec, s.vote.data());
+        }
+    }
+    }
+    return true;
+}
+
+bool BatchPredictor::predict_batch(const cv::Mat &samples, std::vector<double> &out_labels) const {
+    out_labels.resize(samples.rows);
+    return predict_batch(samples, out_labels.data());
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "svm.h"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    //prediction for whole batches of histograms: the SVs are copied once into a contiguous row-major matrix and
+    //every thread of a call allocates scratch for one block of samples, once per call and not per sample
+    //a block's kernel values are a block x SV matrix, one gemm for the dot product kernels and each SV row
+    //streamed once per block for the additive ones, then the decision values and votes follow as in svm_predict_values
+    //works for every kernel but PRECOMPUTED; the model is only read in the constructor
+    class BatchPredictor {
+        public:
+            BatchPredictor(const svm_model *model, int block_size = 64);
+
+            //samples are rows (CV_32F or CV_64F), labels gets one value per row and dec_values, when given,
+            //num_decision_values() per row; both have to hold samples.rows entries
+            //returns false and writes nothing for a PRECOMPUTED model
+            bool predict_batch(const cv::Mat &samples, double *labels, double *dec_values = NULL) const;
+            bool predict_batch(const cv::Mat &samples, std::vector<double> &labels) const;
+
+            int num_decision_values() const { return num_functions; }
+            int dimension() const { return dim; }
+
+        private:
+            struct scratch {
+                std::vector<double> x, norm, kernel, dec;
+                std::vector<int> vote;
+            };
+
+            void kernel_block(const double *x, const double *norm, int rows, double *kernel) const;
+            double decide(const double *kernel, double *dec, int *vote) const;
+
+            svm_parameter param;
+            int nr_class, num_functions, l, dim, stride, block_size;
+            std::vector<int> labels, start, count;
+            std::vector<double> rho;
+
+            //l x stride SV matrix, squared norms for RBF, coefficients[p] for the SVs of pair p in SV order
+            std::vector<double> sv, sv_norm;
+            std::vector<std::vector<double>> coefficients;
+    };
+}
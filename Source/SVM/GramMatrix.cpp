@@ -0,0 +1,170 @@
+#include "GramMatrix.hpp"
+#include "KernelOps.hpp"
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include <assert.h>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+
+    //rows per tile, a pair of tiles of 200-bin histograms stays in L2
+    const int block_size = 32;
+
+    //histograms as one row-major array, Hellinger is a dot product of square roots
+    std::vector<double> pack(const std::vector<Histogram> &samples, int dim, HistogramKernel kernel){
+        std::vector<double> packed(samples.size() * dim);
+        for(size_t i = 0; i < samples.size(); i++){
+            assert((int)samples[i].size() == dim);
+            double *row = &packed[i * dim];
+            for(int k = 0; k < dim; k++){
+                row[k] = kernel == HellingerKernel ? std::sqrt(std::max(samples[i][k], 0.0)) : samples[i][k];
+            }
+        }
+        return packed;
+    }
+
+    std::vector<double> pack(svm_node * const *x, int n, int dim, HistogramKernel kernel){
+        std::vector<double> packed((size_t)n * dim);
+        for(int i = 0; i < n; i++){
+            assert(x[i]->index == SVM_DENSE_ROW && (int)x[i]->value == dim);
+            const double *values = svm_dense_values(x[i]);
+            double *row = &packed[(size_t)i * dim];
+            for(int k = 0; k < dim; k++){
+                row[k] = kernel == HellingerKernel ? std::sqrt(std::max(values[k], 0.0)) : values[k];
+            }
+        }
+        return packed;
+    }
+
+    //tiles of a x b, with symmetric set only tiles on or above the diagonal are computed and mirrored
+    template <class Op> void fill(const double *a, int na, const double *b, int nb, int dim, bool symmetric, svm_node *arena, int stride){
+        std::vector<std::pair<int, int>> tiles;
+        for(int i0 = 0; i0 < na; i0 += block_size){
+            for(int j0 = symmetric ? i0 : 0; j0 < nb; j0 += block_size){
+                tiles.push_back(std::make_pair(i0, j0));
+            }
+        }
+
+#pragma omp parallel for schedule(dynamic)
+        for(int t = 0; t < (int)tiles.size(); t++){
+            int i0 = tiles[t].first, j0 = tiles[t].second;
+            int i1 = std::min(i0 + block_size, na), j1 = std::min(j0 + block_size, nb);
+            for(int i = i0; i < i1; i++){
+                for(int j = symmetric ? std::max(j0, i) : j0; j < j1; j++){
+                    double v = additive<Op>(a + (size_t)i * dim, b + (size_t)j * dim, dim);
+                    arena[(size_t)i * stride + j + 1].value = v;
+                    if(symmetric){
+                        arena[(size_t)j * stride + i + 1].value = v;
+                    }
+                }
+            }
+        }
+    }
+
+    void fill(HistogramKernel kernel, const double *a, int na, const double *b, int nb, int dim, bool symmetric, svm_node *arena, int stride){
+        switch(kernel){
+            case ChiSquaredKernel:
+                fill<chi_squared_op>(a, na, b, nb, dim, symmetric, arena, stride);
+                break;
+            case IntersectionKernel:
+                fill<min_op>(a, na, b, nb, dim, symmetric, arena, stride);
+                break;
+            case HellingerKernel:
+                fill<product_op>(a, na, b, nb, dim, symmetric, arena, stride);
+                break;
+        }
+    }
+
+    double self_kernel(HistogramKernel kernel, const double *x, int dim){
+        //K(x,x) is the L1 norm for chi-squared and intersection, and for Hellinger after the square root
+        return kernel == HellingerKernel ? additive<product_op>(x, x, dim) : additive<min_op>(x, x, dim);
+    }
+
+    void exponentiate(HistogramKernel kernel, double gamma, const std::vector<double> &a, int na, const std::vector<double> &b, int nb, int dim, svm_node *arena, int stride){
+        std::vector<double> self_a(na), self_b(nb);
+        for(int i = 0; i < na; i++){
+            self_a[i] = self_kernel(kernel, &a[(size_t)i * dim], dim);
+        }
+        for(int j = 0; j < nb; j++){
+            self_b[j] = self_kernel(kernel, &b[(size_t)j * dim], dim);
+        }
+
+#pragma omp parallel for
+        for(int i = 0; i < na; i++){
+            svm_node *row = arena + (size_t)i * stride + 1;
+            for(int j = 0; j < nb; j++){
+                row[j].value = std::exp(-gamma * std::max(self_a[i] + self_b[j] - 2 * row[j].value, 0.0));
+            }
+        }
+    }
+}
+
+GramMatrix::GramMatrix() : num_rows(0), num_cols(0) {}
+
+void GramMatrix::allocate(int rows, int cols){
+    num_rows = rows;
+    num_cols = cols;
+    arena.assign((size_t)rows * stride(), svm_node());
+    row_nodes.resize(rows);
+    for(int i = 0; i < rows; i++){
+        svm_node *row = &arena[(size_t)i * stride()];
+        row[0].index = 0;
+        row[0].value = i + 1;
+        for(int j = 0; j < cols; j++){
+            row[j + 1].index = j + 1;
+        }
+        row[cols + 1].index = -1;
+        row_nodes[i] = row;
+    }
+}
+
+void GramMatrix::compute(const std::vector<Histogram> &samples, HistogramKernel kernel, double gamma){
+    int n = samples.size();
+    int dim = n > 0 ? samples[0].size() : 0;
+    allocate(n, n);
+
+    std::vector<double> packed = pack(samples, dim, kernel);
+    fill(kernel, packed.data(), n, packed.data(), n, dim, true, arena.data(), stride());
+    if(gamma > 0){
+        exponentiate(kernel, gamma, packed, n, packed, n, dim, arena.data(), stride());
+    }
+}
+
+void GramMatrix::compute(svm_node * const *x, int l, HistogramKernel kernel, double gamma){
+    int dim = l > 0 ? (int)x[0]->value : 0;
+    allocate(l, l);
+
+    std::vector<double> packed = pack(x, l, dim, kernel);
+    fill(kernel, packed.data(), l, packed.data(), l, dim, true, arena.data(), stride());
+    if(gamma > 0){
+        exponentiate(kernel, gamma, packed, l, packed, l, dim, arena.data(), stride());
+    }
+}
+
+void GramMatrix::compute(const std::vector<Histogram> &samples, const std::vector<Histogram> &training, HistogramKernel kernel, double gamma){
+    int n = samples.size(), m = training.size();
+    int dim = n > 0 ? samples[0].size() : (m > 0 ? training[0].size() : 0);
+    allocate(n, m);
+
+    std::vector<double> a = pack(samples, dim, kernel);
+    std::vector<double> b = pack(training, dim, kernel);
+    fill(kernel, a.data(), n, b.data(), m, dim, false, arena.data(), stride());
+    if(gamma > 0){
+        exponentiate(kernel, gamma, a, n, b, m, dim, arena.data(), stride());
+    }
+}
+
+void GramMatrix::compute_rbf(const std::vector<double> &squared_distances, int n, double gamma){
+    allocate(n, n);
+
+#pragma omp parallel for
+    for(int i = 0; i < n; i++){
+        svm_node *row = &arena[(size_t)i * stride() + 1];
+        const double *d = &squared_distances[(size_t)i * n];
+        for(int j = 0; j < n; j++){
+            row[j].value = std::exp(-gamma * d[j]);
+        }
+    }
+}
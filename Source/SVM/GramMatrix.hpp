@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include "svm.h"
+#include "../Util/Types.hpp"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    //kernel values between histogram sets, stored as libsvm PRECOMPUTED rows:
+    //row i is 0:<i+1> 1:K(i,0) ... n:K(i,n-1), so nodes() goes straight into svm_problem.x for training
+    //or into svm_predict for the rows of a test x training matrix
+    //chi-squared is the additive form sum 2xy/(x+y), gamma > 0 turns any of the kernels into
+    //exp(-gamma * (K(x,x) + K(y,y) - 2K(x,y))), which for chi-squared is the usual exp-chi2 kernel
+    class GramMatrix {
+        public:
+            GramMatrix();
+
+            //training x training, only the upper triangle is computed
+            void compute(const std::vector<Histogram> &samples, HistogramKernel kernel, double gamma = 0);
+            //training x training over l dense rows (svm_alloc_dense), e.g. the x of a problem
+            void compute(svm_node * const *x, int l, HistogramKernel kernel, double gamma = 0);
+            //test x training
+            void compute(const std::vector<Histogram> &samples, const std::vector<Histogram> &training, HistogramKernel kernel, double gamma = 0);
+            //exp(-gamma d) from an n x n row-major matrix of squared distances, so one distance matrix serves every RBF gamma
+            void compute_rbf(const std::vector<double> &squared_distances, int n, double gamma);
+
+            int rows() const { return num_rows; }
+            int cols() const { return num_cols; }
+            double operator()(int i, int j) const { return arena[(size_t)i * stride() + j + 1].value; }
+            svm_node **nodes() { return row_nodes.data(); }
+
+        private:
+            void allocate(int rows, int cols);
+            int stride() const { return num_cols + 2; }
+
+            int num_rows, num_cols;
+            std::vector<svm_node> arena;
+            std::vector<svm_node*> row_nodes;
+    };
+}
@@ -0,0 +1,235 @@
+#include "GridSearch.hpp"
+#include "GramMatrix.hpp"
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <map>
+#include <memory>
+#include <utility>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    bool uses_gamma(int kernel_type){
+        return kernel_type == RBF || kernel_type == POLY || kernel_type == SIGMOID;
+    }
+
+    //all pairwise squared distances from linear kernel values
+    void squared_distances(const svm_problem *prob, std::vector<double> &distances){
+        int n = prob->l;
+        svm_parameter linear = svm_parameter();
+        linear.kernel_type = LINEAR;
+
+        std::vector<double> norms(n);
+        for(int i = 0; i < n; i++){
+            norms[i] = svm_kernel_value(prob->x[i], prob->x[i], &linear);
+        }
+
+        distances.assign((size_t)n * n, 0.0);
+#pragma omp parallel for schedule(dynamic, 16)
+        for(int i = 0; i < n; i++){
+            for(int j = i + 1; j < n; j++){
+                double d = std::max(norms[i] + norms[j] - 2 * svm_kernel_value(prob->x[i], prob->x[j], &linear), 0.0);
+                distances[(size_t)i * n + j] = d;
+                distances[(size_t)j * n + i] = d;
+            }
+        }
+    }
+}
+
+GridSearch::GridSearch(const svm_problem *prob, const svm_parameter &param, int folds, unsigned int seed)
+    : prob(prob), param(param), folds(std::max(2, std::min(folds, prob->l))), fold(prob->l)
+{
+    //stratified: the samples of each class are shuffled and dealt over the folds
+    std::map<double, std::vector<int>> classes;
+    for(int i = 0; i < prob->l; i++){
+        classes[prob->y[i]].push_back(i);
+    }
+    std::mt19937 generator(seed);
+    int next = 0;
+    for(auto &c : classes){
+        std::shuffle(c.second.begin(), c.second.end(), generator);
+        for(size_t k = 0; k < c.second.size(); k++){
+            fold[c.second[k]] = next++ % this->folds;
+        }
+    }
+}
+
+GridSearchResult GridSearch::search(const std::vector<double> &C, const std::vector<double> &gamma_values, int eta, size_t memory_budget){
+    GridSearchResult result;
+    result.best = param;
+    result.best_accuracy = 0;
+    result.C = C;
+    result.gamma = uses_gamma(param.kernel_type) ? gamma_values : std::vector<double>(1, param.gamma);
+
+    const char *error = svm_check_parameter(prob, &param);
+    if(error != NULL || param.svm_type != C_SVC || C.empty() || result.gamma.empty()){
+        std::cout << "GridSearch: " << (error ? error : "needs C-SVC and non-empty C and gamma values") << std::endl;
+        return result;
+    }
+
+    int n = prob->l, nC = C.size(), nG = result.gamma.size();
+    int threads = std::max(param.nr_thread, 1);
+
+    //one distance matrix plus one set of kernel rows per concurrently trained gamma
+    bool precomputed = false;
+    int concurrency = threads;
+    size_t distance_bytes = (size_t)n * n * sizeof(double);
+    size_t rows_bytes = (size_t)n * (n + 2) * sizeof(svm_node);
+    if(param.kernel_type == RBF && memory_budget >= distance_bytes + rows_bytes){
+        precomputed = true;
+        concurrency = std::min<size_t>(threads, (memory_budget - distance_bytes) / rows_bytes);
+    }
+    std::vector<double> distances;
+    if(precomputed){
+        squared_distances(prob, distances);
+    }
+
+    std::vector<int> by_C(nC);
+    for(int c = 0; c < nC; c++){
+        by_C[c] = c;
+    }
+    std::sort(by_C.begin(), by_C.end(), [&](int a, int b){ return C[a] < C[b]; });
+
+    //correct[f][g][c], filled by the fold that tests it
+    std::vector<std::vector<std::vector<int>>> correct(folds, std::vector<std::vector<int>>(nG, std::vector<int>(nC, 0)));
+    std::vector<int> fold_size(folds, 0);
+    for(int i = 0; i < n; i++){
+        fold_size[fold[i]]++;
+    }
+
+    std::vector<std::vector<bool>> alive(nG, std::vector<bool>(nC, true));
+    result.folds_evaluated.assign(nG, std::vector<int>(nC, 0));
+    result.accuracy.assign(nG, std::vector<double>(nC, 0.0));
+
+    //without halving all folds form one round, with halving every fold is a round
+    int rounds = eta > 1 ? folds : 1;
+    for(int round = 0; round < rounds; round++){
+        std::vector<int> round_folds;
+        for(int f = 0; f < folds; f++){
+            if(eta <= 1 || f == round){
+                round_folds.push_back(f);
+            }
+        }
+
+        //a task is one gamma on its folds, per fold when every task computes its own kernel values anyway
+        std::vector<std::pair<int, std::vector<int>>> tasks;
+        for(int g = 0; g < nG; g++){
+            if(std::find(alive[g].begin(), alive[g].end(), true) == alive[g].end()){
+                continue;
+            }
+            if(precomputed){
+                tasks.push_back(std::make_pair(g, round_folds));
+            } else {
+                for(size_t k = 0; k < round_folds.size(); k++){
+                    tasks.push_back(std::make_pair(g, std::vector<int>(1, round_folds[k])));
+                }
+            }
+        }
+
+        int active = std::max(1, std::min<int>(concurrency, tasks.size()));
+        svm_parameter task_param = param;
+        if(active > 1){
+            task_param.nr_thread = 1;
+            task_param.cache_size = param.cache_size / active;
+        }
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(active)
+        for(int t = 0; t < (int)tasks.size(); t++){
+            int g = tasks[t].first;
+            svm_parameter point = task_param;
+            point.gamma = result.gamma[g];
+
+            std::unique_ptr<GramMatrix> gram;
+            svm_node **rows = prob->x;
+            if(precomputed){
+                gram.reset(new GramMatrix());
+                gram->compute_rbf(distances, n, point.gamma);
+                rows = gram->nodes();
+                point.kernel_type = PRECOMPUTED;
+            }
+
+            for(size_t k = 0; k < tasks[t].second.size(); k++){
+                int f = tasks[t].second[k];
+                std::vector<svm_node *> x;
+                std::vector<double> y;
+                std::vector<int> test;
+                for(int i = 0; i < n; i++){
+                    if(fold[i] == f){
+                        test.push_back(i);
+                    } else {
+                        x.push_back(rows[i]);
+                        y.push_back(prob->y[i]);
+                    }
+                }
+                svm_problem sub;
+                sub.l = x.size();
+                sub.x = x.data();
+                sub.y = y.data();
+
+                //the C path of this gamma and fold, each point starts from the solution of the previous one
+                svm_model *previous = NULL;
+                for(int r = 0; r < nC; r++){
+                    int c = by_C[r];
+                    if(!alive[g][c]){
+                        continue;
+                    }
+                    point.C = C[c];
+                    svm_model *model = svm_train_warm(&sub, &point, previous);
+                    int hits = 0;
+                    for(size_t j = 0; j < test.size(); j++){
+                        hits += svm_predict(model, rows[test[j]]) == prob->y[test[j]];
+                    }
+                    correct[f][g][c] = hits;
+                    if(previous){
+                        svm_free_and_destroy_model(&previous);
+                    }
+                    previous = model;
+                }
+                if(previous){
+                    svm_free_and_destroy_model(&previous);
+                }
+            }
+        }
+
+        //accuracy of every point still alive over the folds it has seen
+        std::vector<std::pair<double, std::pair<int, int>>> ranking;
+        for(int g = 0; g < nG; g++){
+            for(int c = 0; c < nC; c++){
+                if(!alive[g][c]){
+                    continue;
+                }
+                int hits = 0, tested = 0;
+                result.folds_evaluated[g][c] += round_folds.size();
+                //a point still alive has been tested on every fold up to this round's last
+                for(int f = 0; f <= round_folds.back(); f++){
+                    hits += correct[f][g][c];
+                    tested += fold_size[f];
+                }
+                result.accuracy[g][c] = tested > 0 ? (double)hits / tested : 0;
+                ranking.push_back(std::make_pair(-result.accuracy[g][c], std::make_pair(g, c)));
+            }
+        }
+
+        if(eta > 1 && round + 1 < rounds){
+            std::stable_sort(ranking.begin(), ranking.end(), [](const std::pair<double, std::pair<int, int>> &a, const std::pair<double, std::pair<int, int>> &b){ return a.first < b.first; });
+            size_t keep = std::max<size_t>(1, (ranking.size() + eta - 1) / eta);
+            for(size_t k = keep; k < ranking.size(); k++){
+                alive[ranking[k].second.first][ranking[k].second.second] = false;
+            }
+        }
+    }
+
+    //best of the points that went through every fold
+    result.best_accuracy = -1;
+    for(int g = 0; g < nG; g++){
+        for(int c = 0; c < nC; c++){
+            if(result.folds_evaluated[g][c] == folds && result.accuracy[g][c] > result.best_accuracy){
+                result.best_accuracy = result.accuracy[g][c];
+                result.best.C = C[c];
+                result.best.gamma = result.gamma[g];
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "svm.h"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    struct GridSearchResult {
+        svm_parameter best;
+        double best_accuracy;
+        std::vector<double> C, gamma;
+        //accuracy[g][c] over folds_evaluated[g][c] folds, points dropped by successive halving keep their partial accuracy
+        std::vector<std::vector<double>> accuracy;
+        std::vector<std::vector<int>> folds_evaluated;
+    };
+
+    //cross-validated C x gamma search for C-SVC
+    //the C values of one gamma and fold are trained in increasing order, each warm started from the last (svm_train_warm)
+    //for RBF the squared distances are computed once and every gamma trains on exp(-gamma d) as precomputed rows,
+    //as long as the matrices fit memory_budget
+    //points are trained concurrently on param.nr_thread threads, each with an equal share of param.cache_size
+    class GridSearch {
+        public:
+            //prob rows are used in place, param is the template for every point (C and gamma are replaced)
+            GridSearch(const svm_problem *prob, const svm_parameter &param, int folds = 5, unsigned int seed = 0);
+
+            //eta > 1 turns on successive halving: after each fold only the best 1/eta of the remaining points go on
+            GridSearchResult search(const std::vector<double> &C, const std::vector<double> &gamma, int eta = 0, size_t memory_budget = (size_t)1 << 30);
+
+        private:
+            const svm_problem *prob;
+            svm_parameter param;
+            int folds;
+            std::vector<int> fold;
+    };
+}
@@ -0,0 +1,168 @@
+#include "IncrementalTraining.hpp"
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    typedef std::vector<std::pair<int, double>> Nonzeros;
+
+    //values at the precision svm_save_model writes SVs with, so an SV read back from a text model and the
+    //row it was trained on canonicalize to the same bits
+    double canonical(double v){
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.8g", v);
+        return strtod(buffer, NULL);
+    }
+
+    //sparse and dense rows with the same values compare equal
+    void nonzeros(const svm_node *p, Nonzeros &row){
+        row.clear();
+        if(p->index == SVM_DENSE_ROW){
+            const double *v = svm_dense_values(const_cast<svm_node *>(p));
+            for(int k = 0; k < (int)p->value; k++){
+                if(v[k] != 0){
+                    row.push_back(std::make_pair(k + 1, canonical(v[k])));
+                }
+            }
+        } else {
+            for(; p->index != -1; ++p){
+                if(p->value != 0){
+                    row.push_back(std::make_pair(p->index, canonical(p->value)));
+                }
+            }
+        }
+    }
+
+    //FNV-1a over the indices and value bits
+    uint64_t hash_row(const Nonzeros &row){
+        uint64_t h = 14695981039346656037ULL;
+        for(size_t k = 0; k < row.size(); k++){
+            uint64_t bits;
+            std::memcpy(&bits, &row[k].second, sizeof(bits));
+            h = (h ^ (uint64_t)row[k].first) * 1099511628211ULL;
+            h = (h ^ bits) * 1099511628211ULL;
+        }
+        return h;
+    }
+}
+
+svm_model *LocalDescriptorAndBagOfFeature::train_incremental(const svm_model *model, const svm_problem *added, const svm_parameter &param, const svm_problem *previous, IncrementalReport *report){
+    if(param.svm_type != C_SVC || model->param.svm_type != C_SVC || model->nSV == NULL){
+        std::cout << "train_incremental: needs a C-SVC model" << std::endl;
+        return NULL;
+    }
+    if(param.kernel_type == PRECOMPUTED){
+        std::cout << "train_incremental: precomputed kernel rows can't be extended with new samples" << std::endl;
+        return NULL;
+    }
+
+    std::vector<double> sv_label(model->l);
+    for(int c = 0, k = 0; c < model->nr_class; c++){
+        for(int j = 0; j < model->nSV[c]; j++){
+            sv_label[k++] = model->label[c];
+        }
+    }
+
+    //svm_train_warm finds the old SVs among the rows by pointer, so a previous row equal to an SV of its class is
+    //replaced by the SV itself, SVs not found in previous (or all of them without it) become rows of their own
+    std::vector<svm_node *> x;
+    std::vector<double> y;
+    std::vector<bool> matched(model->l, false);
+    if(previous != NULL){
+        std::vector<Nonzeros> sv_rows(model->l);
+        for(int i = 0; i < model->l; i++){
+            nonzeros(model->SV[i], sv_rows[i]);
+        }
+
+        //a model trained in this process (or a binary one) knows the rows of its SVs, trust them if they still match
+        std::vector<int> row_sv(previous->l, -1);
+        Nonzeros row;
+        if(model->sv_indices != NULL){
+            for(int i = 0; i < model->l; i++){
+                int r = model->sv_indices[i] - 1;
+                if(r < 0 || r >= previous->l || row_sv[r] >= 0 || sv_label[i] != previous->y[r]){
+                    continue;
+                }
+                nonzeros(previous->x[r], row);
+                if(row == sv_rows[i]){
+                    row_sv[r] = i;
+                    matched[i] = true;
+                }
+            }
+        }
+
+        //the rest by value, e.g. SVs of a text model, which carries no indices
+        std::unordered_multimap<uint64_t, int> by_hash;
+        for(int i = 0; i < model->l; i++){
+            if(!matched[i]){
+                by_hash.insert(std::make_pair(hash_row(sv_rows[i]), i));
+            }
+        }
+        for(int r = 0; r < previous->l && !by_hash.empty(); r++){
+            if(row_sv[r] >= 0){
+                continue;
+            }
+            nonzeros(previous->x[r], row);
+            auto range = by_hash.equal_range(hash_row(row));
+            for(auto it = range.first; it != range.second; ++it){
+                int sv = it->second;
+                if(!matched[sv] && sv_label[sv] == previous->y[r] && sv_rows[sv] == row){
+                    matched[sv] = true;
+                    row_sv[r] = sv;
+                    break;
+                }
+            }
+        }
+
+        for(int r = 0; r < previous->l; r++){
+            x.push_back(row_sv[r] >= 0 ? model->SV[row_sv[r]] : previous->x[r]);
+            y.push_back(previous->y[r]);
+        }
+    }
+    for(int i = 0; i < model->l; i++){
+        if(!matched[i]){
+            x.push_back(model->SV[i]);
+            y.push_back(sv_label[i]);
+        }
+    }
+    x.insert(x.end(), added->x, added->x + added->l);
+    y.insert(y.end(), added->y, added->y + added->l);
+
+    svm_problem prob;
+    prob.l = x.size();
+    prob.x = x.data();
+    prob.y = y.data();
+    const char *error = svm_check_parameter(&prob, &param);
+    if(error){
+        std::cout << "train_incremental: " << error << std::endl;
+        return NULL;
+    }
+
+    svm_model warm = *model;
+    warm.param.C = param.C;
+    svm_model *updated = svm_train_warm(&prob, &param, &warm);
+
+    int unmatched = 0;
+    for(int i = 0; i < model->l; i++){
+        unmatched += !matched[i];
+    }
+    if(previous != NULL && unmatched > 0){
+        std::cout << "train_incremental: " << unmatched << " old SVs were not found in the previous problem and are kept as extra rows" << std::endl;
+    }
+
+    if(report != NULL){
+        report->previous = previous ? previous->l : 0;
+        report->retained_sv = model->l;
+        report->unmatched_sv = previous ? unmatched : 0;
+        report->added = added->l;
+    }
+    std::cout << "retrained on " << prob.l << " samples, " << model->l << " warm started from the old model, " << added->l << " added" << std::endl;
+    return updated;
+}
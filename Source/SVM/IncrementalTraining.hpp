@@ -0,0 +1,23 @@
+#pragma once
+#include "svm.h"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    struct IncrementalReport {
+        int previous;       //rows of the previous problem, 0 when only the old SVs were kept
+        int retained_sv;    //old SVs whose alphas started the solver
+        int unmatched_sv;   //old SVs not found among the previous rows, added as rows of their own
+        int added;
+    };
+
+    //retrains a C-SVC model with new samples, SMO starts from the old alphas (svm_train_warm) so only the part of
+    //the solution the new samples disturb is re-optimized
+    //with previous, the problem the model was trained on, the result is the model of previous + added up to param.eps;
+    //old SVs are matched to its rows through model->sv_indices when the model has them, otherwise by value at the
+    //precision text models store (%.8g), so model and previous can both come from files
+    //without it the old non-SVs are dropped: they had zero alpha and only come back if the new samples move the
+    //margin past them, so the result approximates full retraining
+    //param replaces model->param (model files don't store C, the old model is taken to be trained with param.C)
+    //like svm_train the new model points into the rows of model, added and previous, keep them until it is freed
+    svm_model *train_incremental(const svm_model *model, const svm_problem *added, const svm_parameter &param, const svm_problem *previous = NULL, IncrementalReport *report = NULL);
+}
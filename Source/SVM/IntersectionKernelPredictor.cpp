@@ -0,0 +1,240 @@
+#include "IntersectionKernelPredictor.hpp"
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <assert.h>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    //support vector values of a model as rows of length dim, SVs may be sparse or dense rows
+    int sv_dimension(const svm_model *model){
+        int dim = 0;
+        for(int i = 0; i < model->l; i++){
+            const svm_node *p = model->SV[i];
+            if(p->index == SVM_DENSE_ROW){
+                dim = std::max(dim, (int)p->value);
+            } else {
+                for(; p->index != -1; ++p){
+                    dim = std::max(dim, p->index);
+                }
+            }
+        }
+        return dim;
+    }
+
+    void sv_values(const svm_node *p, int dim, std::vector<double> &row){
+        row.assign(dim, 0.0);
+        if(p->index == SVM_DENSE_ROW){
+            const double *v = svm_dense_values(const_cast<svm_node *>(p));
+            std::copy(v, v + (int)p->value, row.begin());
+        } else {
+            for(; p->index != -1; ++p){
+                row[p->index - 1] = p->value;
+            }
+        }
+    }
+}
+
+IntersectionKernelPredictor::IntersectionKernelPredictor(const svm_model *model, int bins)
+    : valid(model->param.kernel_type == INTERSECTION), svm_type(model->param.svm_type), nr_class(model->nr_class), dim(0), bins(bins)
+{
+    bool one_function = svm_type == ONE_CLASS || svm_type == EPSILON_SVR || svm_type == NU_SVR;
+    num_functions = one_function ? 1 : nr_class * (nr_class - 1) / 2;
+    if(!valid){
+        std::cout << "IntersectionKernelPredictor needs a model trained with the intersection kernel" << std::endl;
+        return;
+    }
+    dim = sv_dimension(model);
+
+    rho.assign(model->rho, model->rho + num_functions);
+    if(!one_function){
+        labels.assign(model->label, model->label + nr_class);
+    }
+
+    std::vector<std::vector<double>> sv(model->l);
+    for(int i = 0; i < model->l; i++){
+        sv_values(model->SV[i], dim, sv[i]);
+    }
+
+    //(index, coefficient) of the SVs in each decision function, in the order svm_predict_values uses
+    std::vector<std::vector<std::pair<int, double>>> members(num_functions);
+    if(one_function){
+        for(int i = 0; i < model->l; i++){
+            members[0].push_back(std::make_pair(i, model->sv_coef[0][i]));
+        }
+    } else {
+        std::vector<int> start(nr_class, 0);
+        for(int i = 1; i < nr_class; i++){
+            start[i] = start[i-1] + model->nSV[i-1];
+        }
+        int p = 0;
+        for(int i = 0; i < nr_class; i++){
+            for(int j = i + 1; j < nr_class; j++, p++){
+                for(int k = 0; k < model->nSV[i]; k++){
+                    members[p].push_back(std::make_pair(start[i] + k, model->sv_coef[j-1][start[i] + k]));
+                }
+                for(int k = 0; k < model->nSV[j]; k++){
+                    members[p].push_back(std::make_pair(start[j] + k, model->sv_coef[i][start[j] + k]));
+                }
+            }
+        }
+    }
+
+    //zeros never contribute to min(x, s) for x >= 0 so they are left out of the tables
+    starts.assign(num_functions * dim + 1, 0);
+    std::vector<std::pair<double, double>> column;
+    for(int f = 0; f < num_functions; f++){
+        for(int d = 0; d < dim; d++){
+            int e = f * dim + d;
+            column.clear();
+            for(size_t m = 0; m < members[f].size(); m++){
+                double s = sv[members[f][m].first][d];
+                if(s != 0){
+                    column.push_back(std::make_pair(s, members[f][m].second));
+                }
+            }
+            std::sort(column.begin(), column.end());
+
+            int count = column.size();
+            starts[e + 1] = starts[e] + count;
+            double sum_below = 0, sum_above = 0;
+            for(int r = 0; r < count; r++){
+                thresholds.push_back(column[r].first);
+                sum_above += column[r].second;
+            }
+            for(int r = 0; r <= count; r++){
+                below.push_back(sum_below);
+                above.push_back(sum_above);
+                if(r < count){
+                    sum_below += column[r].second * column[r].first;
+                    sum_above -= column[r].second;
+                }
+            }
+        }
+    }
+
+    if(bins > 0){
+        table.resize(num_functions * dim * (bins + 1));
+        scale.resize(num_functions * dim);
+        for(int e = 0; e < num_functions * dim; e++){
+            double high = starts[e + 1] > starts[e] ? thresholds[starts[e + 1] - 1] : 0;
+            scale[e] = high > 0 ? bins / high : 0;
+            for(int b = 0; b <= bins; b++){
+                table[e * (bins + 1) + b] = exact_h(e, high * b / bins);
+            }
+        }
+    }
+}
+
+double IntersectionKernelPredictor::exact_h(int entry, double v) const {
+    const double *first = thresholds.data() + starts[entry];
+    const double *last = thresholds.data() + starts[entry + 1];
+    int r = std::lower_bound(first, last, v) - first;
+    int k = starts[entry] + entry + r;
+    return below[k] + v * above[k];
+}
+
+double IntersectionKernelPredictor::h(int entry, double v) const {
+    if(bins == 0){
+        return exact_h(entry, v);
+    }
+
+    //past the largest SV value h is flat, below it piecewise linear between samples
+    const double *samples = &table[entry * (bins + 1)];
+    double t = v * scale[entry];
+    if(t >= bins){
+        return samples[bins];
+    }
+    int b = (int)t;
+    return samples[b] + (t - b) * (samples[b + 1] - samples[b]);
+}
+
+void IntersectionKernelPredictor::nonzeros(const svm_node *x, Nonzeros &values) const {
+    values.clear();
+    if(x->index == SVM_DENSE_ROW){
+        const double *v = svm_dense_values(const_cast<svm_node *>(x));
+        int n = std::min((int)x->value, dim);
+        for(int d = 0; d < n; d++){
+            if(v[d] > 0){
+                values.push_back(std::make_pair(d, v[d]));
+            }
+        }
+    } else {
+        for(; x->index != -1 && x->index <= dim; ++x){
+            if(x->value > 0){
+                values.push_back(std::make_pair(x->index - 1, x->value));
+            }
+        }
+    }
+}
+
+void IntersectionKernelPredictor::nonzeros(const Histogram &x, Nonzeros &values) const {
+    values.clear();
+    int n = std::min((int)x.size(), dim);
+    for(int d = 0; d < n; d++){
+        if(x[d] > 0){
+            values.push_back(std::make_pair(d, x[d]));
+        }
+    }
+}
+
+double IntersectionKernelPredictor::decide(const Nonzeros &x, double *dec_values) const {
+    //tables were never built for a model with another kernel
+    assert(valid);
+    if(!valid){
+        std::fill(dec_values, dec_values + num_functions, NAN);
+        return NAN;
+    }
+
+    for(int f = 0; f < num_functions; f++){
+        double sum = 0;
+        for(size_t k = 0; k < x.size(); k++){
+            sum += h(f * dim + x[k].first, x[k].second);
+        }
+        dec_values[f] = sum - rho[f];
+    }
+
+    if(svm_type == ONE_CLASS){
+        return dec_values[0] > 0 ? 1 : -1;
+    }
+    if(svm_type == EPSILON_SVR || svm_type == NU_SVR){
+        return dec_values[0];
+    }
+
+    std::vector<int> vote(nr_class, 0);
+    int p = 0;
+    for(int i = 0; i < nr_class; i++){
+        for(int j = i + 1; j < nr_class; j++, p++){
+            if(dec_values[p] > 0){
+                ++vote[i];
+            } else {
+                ++vote[j];
+            }
+        }
+    }
+    return labels[std::max_element(vote.begin(), vote.end()) - vote.begin()];
+}
+
+double IntersectionKernelPredictor::predict_values(const svm_node *x, double *dec_values) const {
+    Nonzeros values;
+    nonzeros(x, values);
+    return decide(values, dec_values);
+}
+
+double IntersectionKernelPredictor::predict_values(const Histogram &x, double *dec_values) const {
+    Nonzeros values;
+    nonzeros(x, values);
+    return decide(values, dec_values);
+}
+
+double IntersectionKernelPredictor::predict(const svm_node *x) const {
+    std::vector<double> dec_values(num_functions);
+    return predict_values(x, dec_values.data());
+}
+
+double IntersectionKernelPredictor::predict(const Histogram &x) const {
+    std::vector<double> dec_values(num_functions);
+    return predict_values(x, dec_values.data());
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include "svm.h"
+#include "../Util/Types.hpp"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    //fast evaluation of an INTERSECTION kernel model (Maji, Berg and Malik): each decision function
+    //is a sum over dimensions of h_d(x_d) = sum_i a_i min(x_d, s_id), which only depends on x_d
+    //exact (bins == 0): sorted support vector values with prefix sums, a binary search per dimension
+    //approximate (bins > 0): h_d sampled at bins+1 points and linearly interpolated, O(1) per dimension
+    //support vectors are not touched after construction, cost does not grow with the model
+    //inputs are non-negative histograms, the model is only read in the constructor
+    //a model with any other kernel leaves the predictor invalid and predicting with it is an error
+    class IntersectionKernelPredictor {
+        public:
+            IntersectionKernelPredictor(const svm_model *model, int bins = 0);
+
+            bool is_valid() const { return valid; }
+
+            //same results as svm_predict_values/svm_predict (up to rounding for the exact tables)
+            double predict_values(const svm_node *x, double *dec_values) const;
+            double predict_values(const Histogram &x, double *dec_values) const;
+            double predict(const svm_node *x) const;
+            double predict(const Histogram &x) const;
+
+            int num_decision_values() const { return num_functions; }
+            int dimension() const { return dim; }
+
+        private:
+            typedef std::vector<std::pair<int, double>> Nonzeros;
+            void nonzeros(const svm_node *x, Nonzeros &values) const;
+            void nonzeros(const Histogram &x, Nonzeros &values) const;
+            double h(int entry, double v) const;
+            double exact_h(int entry, double v) const;
+            double decide(const Nonzeros &x, double *dec_values) const;
+
+            bool valid;
+            int svm_type, nr_class, num_functions, dim, bins;
+            std::vector<int> labels;
+            std::vector<double> rho;
+
+            //entry e = function * dim + d, its sorted non-zero SV values are thresholds[starts[e], starts[e+1])
+            //below/above hold count+1 values from starts[e]+e: sum of a_i s_i over s_i < x and sum of a_i over s_i >= x
+            std::vector<int> starts;
+            std::vector<double> thresholds, below, above;
+
+            //approximate tables, (bins+1) samples per entry over [0, max s_id]
+            std::vector<double> table, scale;
+    };
+}
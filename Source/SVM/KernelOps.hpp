@@ -0,0 +1,19 @@
+#pragma once
+#include <algorithm>
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    //per-bin terms of the additive kernels, op(0, y) = 0 for non-negative histograms
+    struct product_op { static inline double apply(double a, double b) { return a*b; } };
+    struct min_op { static inline double apply(double a, double b) { return std::min(a, b); } };
+    struct chi_squared_op { static inline double apply(double a, double b) { double s = a + b; return s > 0 ? 2*a*b/s : 0; } };
+
+    template <class Op> inline double additive(const double * __restrict x, const double * __restrict y, int dim){
+        double sum = 0;
+#pragma omp simd reduction(+:sum)
+        for(int k = 0; k < dim; k++){
+            sum += Op::apply(x[k], y[k]);
+        }
+        return sum;
+    }
+}
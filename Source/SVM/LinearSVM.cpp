@@ -0,0 +1,189 @@
+#include "LinearSVM.hpp"
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <assert.h>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    template <typename T> inline double dot(const double * __restrict w, const T * __restrict x, int dim){
+        double sum = 0;
+#pragma omp simd reduction(+:sum)
+        for(int k = 0; k < dim; k++){
+            sum += w[k] * x[k];
+        }
+        return sum;
+    }
+
+    template <typename T> inline void axpy(double a, const T * __restrict x, double * __restrict w, int dim){
+#pragma omp simd
+        for(int k = 0; k < dim; k++){
+            w[k] += a * x[k];
+        }
+    }
+}
+
+LinearSVM::LinearSVM(double C, LinearLoss loss, double epsilon, int max_iterations, double bias)
+    : C(C), epsilon(epsilon), bias(bias), loss(loss), max_iterations(max_iterations)
+{
+}
+
+//dual coordinate descent for one binary problem with y in {-1,+1}, the bias is an extra constant feature
+template <typename T> void LinearSVM::solve(const cv::Mat &samples, const std::vector<signed char> &y, double *weights, double *bias_weight) const {
+    int l = samples.rows, dim = samples.cols;
+    double diag = loss == L2Loss ? 0.5 / C : 0;
+    double upper = loss == L2Loss ? std::numeric_limits<double>::infinity() : C;
+    double infinity = std::numeric_limits<double>::infinity();
+
+    std::vector<double> alpha(l, 0.0), QD(l);
+    std::vector<int> index(l);
+    for(int i = 0; i < l; i++){
+        const T *x = samples.ptr<T>(i);
+        QD[i] = diag + bias * bias;
+        for(int k = 0; k < dim; k++){
+            QD[i] += (double)x[k] * x[k];
+        }
+        index[i] = i;
+    }
+    std::fill(weights, weights + dim, 0.0);
+    *bias_weight = 0;
+
+    //fixed seed so a model does not depend on thread scheduling
+    std::mt19937 generator(0);
+    int active_size = l;
+    double PGmax_old = infinity, PGmin_old = -infinity;
+    int iteration = 0;
+    for(; iteration < max_iterations; iteration++){
+        double PGmax_new = -infinity, PGmin_new = infinity;
+        std::shuffle(index.begin(), index.begin() + active_size, generator);
+
+        for(int s = 0; s < active_size; s++){
+            int i = index[s];
+            const T *x = samples.ptr<T>(i);
+            double G = y[i] * (dot(weights, x, dim) + *bias_weight * bias) - 1 + alpha[i] * diag;
+
+            double PG = 0;
+            if(alpha[i] == 0){
+                if(G > PGmax_old){
+                    std::swap(index[s--], index[--active_size]);
+                    continue;
+                }
+                if(G < 0){
+                    PG = G;
+                }
+            } else if(alpha[i] == upper){
+                if(G < PGmin_old){
+                    std::swap(index[s--], index[--active_size]);
+                    continue;
+                }
+                if(G > 0){
+                    PG = G;
+                }
+            } else {
+                PG = G;
+            }
+
+            PGmax_new = std::max(PGmax_new, PG);
+            PGmin_new = std::min(PGmin_new, PG);
+
+            if(std::fabs(PG) > 1e-12){
+                double alpha_old = alpha[i];
+                alpha[i] = std::min(std::max(alpha[i] - G / QD[i], 0.0), upper);
+                double d = (alpha[i] - alpha_old) * y[i];
+                axpy(d, x, weights, dim);
+                *bias_weight += d * bias;
+            }
+        }
+
+        if(PGmax_new - PGmin_new <= epsilon){
+            if(active_size == l){
+                break;
+            }
+            //converged on the shrunk set, check again with everything
+            active_size = l;
+            PGmax_old = infinity;
+            PGmin_old = -infinity;
+            continue;
+        }
+        PGmax_old = PGmax_new > 0 ? PGmax_new : infinity;
+        PGmin_old = PGmin_new < 0 ? PGmin_new : -infinity;
+    }
+
+    if(iteration == max_iterations){
+        std::cout << "LinearSVM: reached the iteration limit, consider scaling the data or a larger epsilon" << std::endl;
+    }
+}
+
+bool LinearSVM::train(const cv::Mat &samples, const std::vector<int> &sample_labels){
+    assert(samples.rows == (int)sample_labels.size());
+    assert(samples.type() == CV_32F || samples.type() == CV_64F);
+
+    std::vector<int> classes = sample_labels;
+    std::sort(classes.begin(), classes.end());
+    classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+    if(classes.size() < 2){
+        std::cout << "LinearSVM: training needs at least two classes" << std::endl;
+        return false;
+    }
+    labels = classes;
+
+    int functions = labels.size() == 2 ? 1 : labels.size();
+    w = cv::Mat::zeros(functions, samples.cols + 1, CV_64F);
+
+#pragma omp parallel for schedule(dynamic)
+    for(int c = 0; c < functions; c++){
+        std::vector<signed char> y(samples.rows);
+        for(int i = 0; i < samples.rows; i++){
+            y[i] = sample_labels[i] == labels[c] ? 1 : -1;
+        }
+
+        double *weights = w.ptr<double>(c);
+        if(samples.type() == CV_32F){
+            solve<float>(samples, y, weights, weights + samples.cols);
+        } else {
+            solve<double>(samples, y, weights, weights + samples.cols);
+        }
+    }
+    return true;
+}
+
+bool LinearSVM::train(const std::vector<Histogram> &samples, const std::vector<int> &sample_labels){
+    cv::Mat packed(samples.size(), samples.empty() ? 0 : samples[0].size(), CV_64F);
+    for(size_t i = 0; i < samples.size(); i++){
+        std::copy(samples[i].begin(), samples[i].end(), packed.ptr<double>(i));
+    }
+    return train(packed, sample_labels);
+}
+
+void LinearSVM::decision_values(const cv::Mat &samples, cv::Mat &scores) const {
+    cv::Mat x;
+    samples.convertTo(x, CV_64F);
+
+    int dim = w.cols - 1;
+    cv::gemm(x, w.colRange(0, dim), 1, cv::Mat(), 0, scores, cv::GEMM_2_T);
+    for(int i = 0; i < scores.rows; i++){
+        double *row = scores.ptr<double>(i);
+        for(int c = 0; c < scores.cols; c++){
+            row[c] += w.at<double>(c, dim) * bias;
+        }
+    }
+}
+
+int LinearSVM::predict(const cv::Mat &sample) const {
+    cv::Mat scores;
+    decision_values(sample.reshape(1, 1), scores);
+
+    if(scores.cols == 1){
+        return scores.at<double>(0, 0) > 0 ? labels[0] : labels[1];
+    }
+    cv::Point best;
+    cv::minMaxLoc(scores, 0, 0, 0, &best);
+    return labels[best.x];
+}
+
+int LinearSVM::predict(const Histogram &sample) const {
+    return predict(cv::Mat(sample));
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "../Util/Types.hpp"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    enum LinearLoss { L1Loss, L2Loss }; //hinge, squared hinge
+
+    //linear SVM trained with dual coordinate descent and shrinking (Hsieh et al., as in LIBLINEAR),
+    //no kernel evaluations or cache, each pass is O(samples x dim)
+    //multiclass is one-vs-rest with the classes trained in parallel, two classes train a single function
+    //samples are the rows of a CV_32F or CV_64F matrix and are used in place
+    class LinearSVM {
+        public:
+            LinearSVM(double C = 1, LinearLoss loss = L2Loss, double epsilon = 0.1, int max_iterations = 1000, double bias = 1);
+
+            //returns false and leaves the model untrained when the labels hold fewer than two classes
+            bool train(const cv::Mat &samples, const std::vector<int> &labels);
+            bool train(const std::vector<Histogram> &samples, const std::vector<int> &labels);
+
+            //one row of scores per sample, one column per decision function
+            void decision_values(const cv::Mat &samples, cv::Mat &scores) const;
+            int predict(const cv::Mat &sample) const;
+            int predict(const Histogram &sample) const;
+
+            //one row per decision function, the bias weight is the last column
+            const cv::Mat &weights() const { return w; }
+            const std::vector<int> &classes() const { return labels; }
+
+        private:
+            template <typename T> void solve(const cv::Mat &samples, const std::vector<signed char> &y, double *weights, double *bias_weight) const;
+
+            double C, epsilon, bias;
+            LinearLoss loss;
+            int max_iterations;
+
+            std::vector<int> labels;
+            cv::Mat w;
+    };
+}
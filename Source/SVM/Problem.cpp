@@ -0,0 +1,199 @@
+#include "Problem.hpp"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <stdint.h>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    const char binary_problem_magic[8] = {'L','D','B','O','F','P','R','B'};
+    const int32_t binary_problem_version = 1;
+
+    struct binary_problem_header {
+        char magic[8];
+        int32_t version;
+        int32_t l;
+        int32_t dim;
+        int32_t reserved;
+    };
+
+    int row_dimension(const svm_node *p){
+        if(p->index == SVM_DENSE_ROW){
+            return (int)p->value;
+        }
+        int dim = 0;
+        for(; p->index != -1; ++p){
+            dim = std::max(dim, p->index);
+        }
+        return dim;
+    }
+
+    bool load_binary_problem(std::ifstream &filein, const std::string &filename, svm_problem &prob){
+        filein.seekg(0, std::ios::end);
+        uint64_t file_size = (uint64_t)filein.tellg();
+        filein.seekg(0);
+
+        binary_problem_header header;
+        filein.read((char *)&header, sizeof(header));
+        if(!filein || header.version != binary_problem_version || header.l < 0 || header.dim < 0){
+            std::cout << "unsupported binary problem file " << filename << std::endl;
+            return false;
+        }
+
+        //labels and rows are l * (dim + 1) doubles, checked by division so a corrupt header can't wrap the product
+        uint64_t values = (file_size - sizeof(header)) / sizeof(double);
+        if(header.l > 0 && ((uint64_t)header.dim + 1 > values / header.l
+                || file_size - sizeof(header) != (uint64_t)header.l * (header.dim + 1) * sizeof(double))){
+            std::cout << "truncated binary problem file " << filename << " (" << header.l << " rows of " << header.dim << " values don't fit its " << file_size << " bytes)" << std::endl;
+            return false;
+        }
+
+        svm_node **x = header.l > 0 ? svm_alloc_dense(header.l, header.dim) : NULL;
+        if(header.l > 0 && x == NULL){
+            std::cout << "can't allocate " << header.l << " rows of " << header.dim << " values for " << filename << std::endl;
+            return false;
+        }
+        prob.l = header.l;
+        prob.x = x;
+        prob.y = new double[prob.l];
+        filein.read((char *)prob.y, sizeof(double) * prob.l);
+        for(int i = 0; i < prob.l && filein; i++){
+            filein.read((char *)svm_dense_values(prob.x[i]), sizeof(double) * header.dim);
+        }
+        if(!filein){
+            std::cout << "truncated binary problem file " << filename << std::endl;
+            free_problem(prob);
+            return false;
+        }
+        return true;
+    }
+
+    bool load_text_problem(std::ifstream &filein, const std::string &filename, svm_problem &prob){
+        std::vector<double> labels;
+        std::vector<size_t> starts;
+        std::vector<svm_node> nodes;
+        std::string line;
+        int line_number = 0;
+        while(std::getline(filein, line)){
+            line_number++;
+            const char *p = line.c_str();
+            char *end;
+            double label = strtod(p, &end);
+            if(end == p){
+                continue; //blank line
+            }
+            labels.push_back(label);
+            starts.push_back(nodes.size());
+            for(p = end; ; p = end){
+                svm_node node;
+                node.index = (int)strtol(p, &end, 10);
+                if(end == p || *end != ':'){
+                    break;
+                }
+                p = end + 1;
+                node.value = strtod(p, &end);
+                if(end == p){
+                    break;
+                }
+                nodes.push_back(node);
+            }
+            while(isspace((unsigned char)*p)){
+                ++p;
+            }
+            if(*p != '\0'){
+                std::cout << "invalid input at line " << line_number << " of " << filename << std::endl;
+                return false;
+            }
+            svm_node terminator = { -1, 0.0 };
+            nodes.push_back(terminator);
+        }
+
+        prob.l = labels.size();
+        prob.y = new double[prob.l];
+        prob.x = new svm_node *[prob.l];
+        svm_node *block = new svm_node[nodes.size()];
+        std::copy(nodes.begin(), nodes.end(), block);
+        for(int i = 0; i < prob.l; i++){
+            prob.y[i] = labels[i];
+            prob.x[i] = block + starts[i];
+        }
+        if(prob.l == 0){
+            delete[] block;
+        }
+        return true;
+    }
+}
+
+bool LocalDescriptorAndBagOfFeature::load_problem(const std::string &filename, svm_problem &prob){
+    std::ifstream filein(filename, std::ios::binary);
+    if(!filein.is_open()){
+        std::cout << "can't open problem file " << filename << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(binary_problem_magic)];
+    filein.read(magic, sizeof(magic));
+    bool binary = filein && memcmp(magic, binary_problem_magic, sizeof(magic)) == 0;
+    filein.clear();
+    filein.seekg(0);
+    return binary ? load_binary_problem(filein, filename, prob) : load_text_problem(filein, filename, prob);
+}
+
+bool LocalDescriptorAndBagOfFeature::save_problem_binary(const std::string &filename, const svm_problem &prob){
+    int dim = 0;
+    for(int i = 0; i < prob.l; i++){
+        dim = std::max(dim, row_dimension(prob.x[i]));
+    }
+
+    std::ofstream fileout(filename, std::ios::binary);
+    if(!fileout.is_open()){
+        std::cout << "can't open problem file " << filename << std::endl;
+        return false;
+    }
+    binary_problem_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, binary_problem_magic, sizeof(header.magic));
+    header.version = binary_problem_version;
+    header.l = prob.l;
+    header.dim = dim;
+    fileout.write((const char *)&header, sizeof(header));
+    fileout.write((const char *)prob.y, sizeof(double) * prob.l);
+
+    std::vector<double> row;
+    for(int i = 0; i < prob.l; i++){
+        const svm_node *p = prob.x[i];
+        row.assign(dim, 0.0);
+        if(p->index == SVM_DENSE_ROW){
+            const double *v = svm_dense_values(const_cast<svm_node *>(p));
+            std::copy(v, v + (int)p->value, row.begin());
+        } else {
+            for(; p->index != -1; ++p){
+                if(p->index >= 1){
+                    row[p->index - 1] = p->value;
+                }
+            }
+        }
+        fileout.write((const char *)row.data(), sizeof(double) * dim);
+    }
+    return (bool)fileout;
+}
+
+void LocalDescriptorAndBagOfFeature::free_problem(svm_problem &prob){
+    if(prob.l > 0 && prob.x[0]->index == SVM_DENSE_ROW){
+        svm_free_dense(prob.x);
+    } else {
+        if(prob.l > 0){
+            delete[] prob.x[0];
+        }
+        delete[] prob.x;
+    }
+    delete[] prob.y;
+    prob.l = 0;
+    prob.x = NULL;
+    prob.y = NULL;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include "svm.h"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    //reads a problem in the libsvm text format ("label index:value ..." per line), the rows are sparse and share one block,
+    //or one written by save_problem_binary (detected from the header), the rows are then dense (svm_alloc_dense)
+    bool load_problem(const std::string &filename, svm_problem &prob);
+
+    //binary problem file: a versioned header with the number of rows and the dimension, the labels, then every row
+    //as dim doubles (sparse rows are expanded), loading reads them straight into dense rows without parsing
+    bool save_problem_binary(const std::string &filename, const svm_problem &prob);
+
+    //releases a problem read by load_problem
+    void free_problem(svm_problem &prob);
+}
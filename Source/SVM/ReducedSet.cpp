@@ -0,0 +1,239 @@
+#include "ReducedSet.hpp"
+#include "../Util/Clustering.hpp"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    int sv_dimension(const svm_model *model){
+        int dim = 0;
+        for(int i = 0; i < model->l; i++){
+            const svm_node *p = model->SV[i];
+            if(p->index == SVM_DENSE_ROW){
+                dim = std::max(dim, (int)p->value);
+            } else {
+                for(; p->index != -1; ++p){
+                    dim = std::max(dim, p->index);
+                }
+            }
+        }
+        return dim;
+    }
+
+    void sv_values(const svm_node *p, int dim, std::vector<double> &row){
+        row.assign(dim, 0.0);
+        if(p->index == SVM_DENSE_ROW){
+            const double *v = svm_dense_values(const_cast<svm_node *>(p));
+            std::copy(v, v + (int)p->value, row.begin());
+        } else {
+            for(; p->index != -1; ++p){
+                row[p->index - 1] = p->value;
+            }
+        }
+    }
+
+    //rows as sparse svm_node lists in one block, as svm_load_model stores them, so free_sv = 1 releases them
+    svm_node **sparse_rows(const std::vector<std::vector<double>> &rows){
+        size_t nodes = 0;
+        for(size_t i = 0; i < rows.size(); i++){
+            nodes += std::count_if(rows[i].begin(), rows[i].end(), [](double v){ return v != 0; }) + 1;
+        }
+        svm_node *block = (svm_node *)malloc(sizeof(svm_node) * std::max<size_t>(nodes, 1));
+        svm_node **x = (svm_node **)malloc(sizeof(svm_node *) * std::max<size_t>(rows.size(), 1));
+        svm_node *p = block;
+        for(size_t i = 0; i < rows.size(); i++){
+            x[i] = p;
+            for(size_t k = 0; k < rows[i].size(); k++){
+                if(rows[i][k] != 0){
+                    p->index = k + 1;
+                    p->value = rows[i][k];
+                    ++p;
+                }
+            }
+            p->index = -1;
+            ++p;
+        }
+        return x;
+    }
+}
+
+svm_model *LocalDescriptorAndBagOfFeature::reduce_support_vectors(const svm_model *model, double fraction, const svm_problem *validation, ReductionReport *report, int iteration_bound, double ridge){
+    const svm_parameter &param = model->param;
+    if(param.kernel_type == PRECOMPUTED){
+        std::cout << "reduce_support_vectors: precomputed kernel models have no vectors to merge" << std::endl;
+        return NULL;
+    }
+
+    //regression and one-class models have a single decision function over one group of SVs
+    bool one_function = model->nSV == NULL;
+    int groups = one_function ? 1 : model->nr_class;
+    std::vector<int> start(groups, 0), count(groups, model->l);
+    if(!one_function){
+        for(int c = 0; c < groups; c++){
+            count[c] = model->nSV[c];
+            start[c] = c > 0 ? start[c-1] + count[c-1] : 0;
+        }
+    }
+
+    int dim = sv_dimension(model);
+    std::vector<std::vector<double>> sv(model->l);
+    for(int i = 0; i < model->l; i++){
+        sv_values(model->SV[i], dim, sv[i]);
+    }
+
+    //centers of each group, groups smaller than the target are kept as they are
+    std::vector<std::vector<double>> centers;
+    std::vector<int> reduced_start(groups), reduced_count(groups);
+    for(int c = 0; c < groups; c++){
+        std::vector<std::vector<double>> members(sv.begin() + start[c], sv.begin() + start[c] + count[c]);
+        int K = std::max(1, (int)std::ceil(fraction * count[c]));
+        std::vector<std::vector<double>> group_centers;
+        if(K >= count[c]){
+            group_centers = members;
+        } else {
+            std::vector<int> labels, sizes;
+            kmeans(members, K, labels, group_centers, sizes, iteration_bound, 0);
+        }
+        reduced_start[c] = centers.size();
+        reduced_count[c] = group_centers.size();
+        centers.insert(centers.end(), group_centers.begin(), group_centers.end());
+    }
+    int M = centers.size();
+
+    svm_model *reduced = (svm_model *)malloc(sizeof(svm_model));
+    memset(reduced, 0, sizeof(svm_model));
+    reduced->param = param;
+    reduced->nr_class = model->nr_class;
+    reduced->l = M;
+    reduced->SV = sparse_rows(centers);
+    reduced->free_sv = 1;
+    reduced->mapping = NULL;
+
+    //kernel values of the centers against themselves and against the original SVs
+    cv::Mat Kzz(M, M, CV_64F), Kzs(M, model->l, CV_64F);
+#pragma omp parallel for schedule(dynamic)
+    for(int a = 0; a < M; a++){
+        for(int b = 0; b < M; b++){
+            Kzz.at<double>(a, b) = svm_kernel_value(reduced->SV[a], reduced->SV[b], &param);
+        }
+        for(int s = 0; s < model->l; s++){
+            Kzs.at<double>(a, s) = svm_kernel_value(reduced->SV[a], model->SV[s], &param);
+        }
+    }
+
+    int num_functions = one_function ? 1 : model->nr_class * (model->nr_class - 1) / 2;
+    int coefficient_rows = model->nr_class - 1;
+    reduced->sv_coef = (double **)malloc(sizeof(double *) * coefficient_rows);
+    for(int r = 0; r < coefficient_rows; r++){
+        reduced->sv_coef[r] = (double *)calloc(std::max(M, 1), sizeof(double));
+    }
+    reduced->rho = (double *)malloc(sizeof(double) * num_functions);
+    std::copy(model->rho, model->rho + num_functions, reduced->rho);
+
+    //decision function p covers groups (i, j), a member of group c keeps its coefficient in row j-1 if c == i,
+    //in row i if c == j, as in svm_predict_values; the single function of a one-class or regression model is (0, -1)
+    std::vector<std::pair<int, int>> functions;
+    if(one_function){
+        functions.push_back(std::make_pair(0, -1));
+    }
+    for(int i = 0; i < groups && !one_function; i++){
+        for(int j = i + 1; j < groups; j++){
+            functions.push_back(std::make_pair(i, j));
+        }
+    }
+
+    for(size_t p = 0; p < functions.size(); p++){
+        int i = functions[p].first, j = functions[p].second;
+        std::vector<int> z, z_row, s;
+        std::vector<double> alpha;
+        for(int c : {i, j}){
+            if(c < 0){
+                continue;
+            }
+            int row = one_function ? 0 : (c == i ? j - 1 : i);
+            for(int k = 0; k < reduced_count[c]; k++){
+                z.push_back(reduced_start[c] + k);
+                z_row.push_back(row);
+            }
+            for(int k = 0; k < count[c]; k++){
+                s.push_back(start[c] + k);
+                alpha.push_back(model->sv_coef[row][start[c] + k]);
+            }
+        }
+
+        cv::Mat A(z.size(), z.size(), CV_64F), b(z.size(), 1, CV_64F), beta;
+        for(size_t r = 0; r < z.size(); r++){
+            for(size_t c = 0; c < z.size(); c++){
+                A.at<double>(r, c) = Kzz.at<double>(z[r], z[c]) + (r == c ? ridge : 0);
+            }
+            double sum = 0;
+            for(size_t k = 0; k < s.size(); k++){
+                sum += Kzs.at<double>(z[r], s[k]) * alpha[k];
+            }
+            b.at<double>(r, 0) = sum;
+        }
+        if(!cv::solve(A, b, beta, cv::DECOMP_CHOLESKY)){
+            cv::solve(A, b, beta, cv::DECOMP_SVD);
+        }
+
+        for(size_t r = 0; r < z.size(); r++){
+            reduced->sv_coef[z_row[r]][z[r]] = beta.at<double>(r, 0);
+        }
+    }
+
+    if(!one_function){
+        reduced->label = (int *)malloc(sizeof(int) * model->nr_class);
+        reduced->nSV = (int *)malloc(sizeof(int) * model->nr_class);
+        std::copy(model->label, model->label + model->nr_class, reduced->label);
+        std::copy(reduced_count.begin(), reduced_count.end(), reduced->nSV);
+    }
+    //the decision values hardly move, so the sigmoid fits stay usable
+    if(model->probA){
+        reduced->probA = (double *)malloc(sizeof(double) * num_functions);
+        std::copy(model->probA, model->probA + num_functions, reduced->probA);
+    }
+    if(model->probB){
+        reduced->probB = (double *)malloc(sizeof(double) * num_functions);
+        std::copy(model->probB, model->probB + num_functions, reduced->probB);
+    }
+
+    if(validation != NULL && report != NULL){
+        compare_models(model, reduced, validation, *report);
+        std::cout << "reduced " << report->original_sv << " to " << report->reduced_sv << " support vectors, "
+                  << "agreement " << report->agreement << ", accuracy " << report->original_accuracy << " -> " << report->reduced_accuracy << std::endl;
+    }
+    return reduced;
+}
+
+void LocalDescriptorAndBagOfFeature::compare_models(const svm_model *original, const svm_model *reduced, const svm_problem *validation, ReductionReport &report){
+    report.original_sv = original->l;
+    report.reduced_sv = reduced->l;
+
+    int functions = original->nSV == NULL ? 1 : original->nr_class * (original->nr_class - 1) / 2;
+    int same = 0, original_hits = 0, reduced_hits = 0;
+    double max_error = 0;
+#pragma omp parallel for reduction(+:same, original_hits, reduced_hits) reduction(max:max_error)
+    for(int i = 0; i < validation->l; i++){
+        std::vector<double> a(functions), b(functions);
+        double la = svm_predict_values(original, validation->x[i], a.data());
+        double lb = svm_predict_values(reduced, validation->x[i], b.data());
+        same += la == lb;
+        original_hits += la == validation->y[i];
+        reduced_hits += lb == validation->y[i];
+        for(int f = 0; f < functions; f++){
+            max_error = std::max(max_error, std::fabs(a[f] - b[f]));
+        }
+    }
+
+    int n = std::max(validation->l, 1);
+    report.agreement = (double)same / n;
+    report.original_accuracy = (double)original_hits / n;
+    report.reduced_accuracy = (double)reduced_hits / n;
+    report.max_decision_error = max_error;
+}
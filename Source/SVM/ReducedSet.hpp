@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+#include "svm.h"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    //how a reduced model compares with the original on a validation set
+    struct ReductionReport {
+        int original_sv, reduced_sv;
+        double agreement;                //fraction of validation samples given the same label
+        double original_accuracy, reduced_accuracy;
+        double max_decision_error;       //largest change of a decision value
+    };
+
+    //reduced-set approximation of a trained model: the SVs of every class are replaced by fraction of as many
+    //k-means centers (near-duplicate SVs merge into one), and for each decision function the coefficients of
+    //the centers are fit by least squares in feature space, beta = (Kzz + ridge I)^-1 Kzs alpha, rho is kept
+    //the result is an ordinary model (free with svm_free_and_destroy_model, save with either format)
+    //validation, when given, fills report; PRECOMPUTED models can't be reduced and return NULL
+    //works best with RBF; the intersection and chi-squared decision functions have a knot at every SV value that
+    //averaging removes, for those IntersectionKernelPredictor gives a cost independent of the SV count instead
+    svm_model *reduce_support_vectors(const svm_model *model, double fraction, const svm_problem *validation = NULL, ReductionReport *report = NULL, int iteration_bound = 20, double ridge = 1e-8);
+
+    void compare_models(const svm_model *original, const svm_model *reduced, const svm_problem *validation, ReductionReport &report);
+}
@@ -7,7 +7,15 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 #include "svm.h"
+#include "KernelOps.hpp"
 int libsvm_version = LIBSVM_VERSION;
 typedef float Qfloat;
 typedef signed char schar;
@@ -37,6 +45,8 @@ static inline double powi(double base, int times)
 #define INF HUGE_VAL
 #define TAU 1e-12
 #define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+#define PARALLEL_MIN_SIZE 4096	// shorter gradient updates are not worth waking up the threads
+#define SHARED_CACHE_LOCAL_SHARE 0.125	// with a shared kernel cache, a subproblem keeps this much for its hot columns
 
 static void print_string_stdout(const char *s)
 {
@@ -184,6 +194,155 @@ void Cache::swap_index(int i, int j)
 	}
 }
 
+//
+// Dense rows and the additive kernels shared by the dense and sparse formats
+//
+// every kernel here is a sum over dimensions of op(x_k, y_k) with op(0, y) = 0
+// (for non-negative histograms), so sparse rows only need their common indices
+// and a sparse row against a dense one only needs the sparse entries
+//
+#define DENSE_ALIGN 32
+
+static inline bool is_dense(const svm_node *x) { return x->index == SVM_DENSE_ROW; }
+static inline const double *dense_values(const svm_node *x) { return (const double *)(x+1); }
+static inline int dense_dim(const svm_node *x) { return (int)x->value; }
+
+using LocalDescriptorAndBagOfFeature::product_op;
+using LocalDescriptorAndBagOfFeature::min_op;
+using LocalDescriptorAndBagOfFeature::chi_squared_op;
+using LocalDescriptorAndBagOfFeature::additive;
+
+template <class Op> static double additive_kernel(const svm_node *px, const svm_node *py)
+{
+	double sum = 0;
+	if(is_dense(px) && is_dense(py))
+		return additive<Op>(dense_values(px),dense_values(py),min(dense_dim(px),dense_dim(py)));
+
+	if(is_dense(px) || is_dense(py))
+	{
+		if(is_dense(py))
+			swap(px,py);
+		const double *x = dense_values(px);
+		int n = dense_dim(px);
+		for(;py->index != -1 && py->index <= n;++py)
+			sum += Op::apply(x[py->index-1],py->value);
+		return sum;
+	}
+
+	while(px->index != -1 && py->index != -1)
+	{
+		if(px->index == py->index)
+		{
+			sum += Op::apply(px->value,py->value);
+			++px;
+			++py;
+		}
+		else
+		{
+			if(px->index > py->index)
+				++py;
+			else
+				++px;
+		}
+	}
+	return sum;
+}
+
+static double dense_squared_distance(const double * __restrict x, const double * __restrict y, int n)
+{
+	double sum = 0;
+#pragma omp simd reduction(+:sum)
+	for(int k=0;k<n;k++)
+	{
+		double d = x[k]-y[k];
+		sum += d*d;
+	}
+	return sum;
+}
+
+// one block for all rows: each row is a header node followed by its values at a 32-byte boundary
+svm_node **svm_alloc_dense(int l, int dim)
+{
+	size_t values_size = ((sizeof(double)*dim + DENSE_ALIGN-1)/DENSE_ALIGN)*DENSE_ALIGN;
+	size_t stride = DENSE_ALIGN + values_size;
+	char *block;
+	if(posix_memalign((void **)&block,DENSE_ALIGN,stride*l) != 0)
+		return NULL;
+
+	svm_node **x = Malloc(svm_node *,l);
+	if(x == NULL)
+	{
+		free(block);
+		return NULL;
+	}
+	for(int i=0;i<l;i++)
+	{
+		x[i] = (svm_node *)(block + i*stride + DENSE_ALIGN - sizeof(svm_node));
+		x[i]->index = SVM_DENSE_ROW;
+		x[i]->value = dim;
+	}
+	return x;
+}
+
+double *svm_dense_values(svm_node *x)
+{
+	return (double *)(x+1);
+}
+
+void svm_free_dense(svm_node **x)
+{
+	if(x == NULL)
+		return;
+	free((char *)x[0] - (DENSE_ALIGN - sizeof(svm_node)));
+	free(x);
+}
+
+//
+// Kernel cache shared by subproblems
+//
+// rows are the samples of the problem the cache was created for, other problems find theirs by
+// pointer, so pairs and folds that hold a sample share its row; a row has room for K(a,b) with
+// every b and is filled on demand, NaN marking the values not computed yet
+// rows being read are pinned, the least recently used unpinned ones are dropped to stay within
+// the budget (pinned rows may exceed it)
+//
+struct svm_kernel_cache
+{
+public:
+	svm_kernel_cache(const svm_problem *prob, const svm_parameter *param);
+	~svm_kernel_cache();
+
+	bool accepts(const svm_parameter& param) const;
+	int index_of(const svm_node *x) const;	// -1 if x is not a row of the problem
+	// data[j] = K(a,global[j]) for j in [start,len)
+	void get_row(int a, const int *global, Qfloat *data, int start, int len, int nr_thread);
+	void get_stats(svm_kernel_cache_stats *stats);
+private:
+	struct row_t
+	{
+		row_t *prev, *next;	// LRU list of the unpinned rows
+		std::atomic<Qfloat> *data;
+		int pins;
+	};
+
+	int l;
+	const svm_node **x;
+	double *x_square;	// RBF only, as Kernel keeps it, so shared values are those of Kernel::kernel_rbf
+	svm_parameter param;
+	std::unordered_map<const svm_node *,int> index;
+	row_t *rows;
+	row_t lru_head;
+	size_t budget, bytes, peak_bytes;
+	std::mutex lock;
+	std::atomic<unsigned long long> hits, misses;
+	unsigned long long evictions;
+
+	row_t *acquire(int a);
+	void release(row_t *r);
+	void lru_delete(row_t *r);
+	void lru_insert(row_t *r);
+};
+
 //
 // Kernel evaluation
 //
@@ -196,6 +355,7 @@ public:
 	virtual Qfloat *get_Q(int column, int len) const = 0;
 	virtual double *get_QD() const = 0;
 	virtual void swap_index(int i, int j) const = 0;
+	virtual int get_nr_thread() const { return 1; }
 	virtual ~QMatrix() {}
 };
 
@@ -212,10 +372,30 @@ public:
 	{
 		swap(x[i],x[j]);
 		if(x_square) swap(x_square[i],x_square[j]);
+		if(global) swap(global[i],global[j]);
 	}
+	virtual int get_nr_thread() const { return nr_thread; }
+	friend struct svm_kernel_cache;
 protected:
 
 	double (Kernel::*kernel_function)(int i, int j) const;
+	const int nr_thread;	// threads filling one kernel column
+	svm_kernel_cache *shared;	// NULL when kernel values are computed directly
+	int *global;		// row of each sample in the shared cache
+
+	// K(i,j) for j in [start,len)
+	void kernel_row(int i, Qfloat *data, int start, int len) const
+	{
+		if(shared)
+			shared->get_row(global[i],global,data,start,len,nr_thread);
+		else
+		{
+			int j;
+#pragma omp parallel for private(j) schedule(guided) num_threads(nr_thread) if(nr_thread > 1)
+			for(j=start;j<len;j++)
+				data[j] = (Qfloat)(this->*kernel_function)(i,j);
+		}
+	}
 
 private:
 	const svm_node **x;
@@ -228,6 +408,7 @@ private:
 	const double coef0;
 
 	static double dot(const svm_node *px, const svm_node *py);
+	static double squared_distance(const svm_node *px, const svm_node *py);
 	double kernel_linear(int i, int j) const
 	{
 		return dot(x[i],x[j]);
@@ -248,10 +429,18 @@ private:
 	{
 		return x[i][(int)(x[j][0].value)].value;
 	}
+	double kernel_intersection(int i, int j) const
+	{
+		return additive_kernel<min_op>(x[i],x[j]);
+	}
+	double kernel_chi_squared(int i, int j) const
+	{
+		return additive_kernel<chi_squared_op>(x[i],x[j]);
+	}
 };
 
 Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
-:kernel_type(param.kernel_type), degree(param.degree),
+:nr_thread(param.nr_thread), kernel_type(param.kernel_type), degree(param.degree),
  gamma(param.gamma), coef0(param.coef0)
 {
 	switch(kernel_type)
@@ -271,6 +460,12 @@ Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
 		case PRECOMPUTED:
 			kernel_function = &Kernel::kernel_precomputed;
 			break;
+		case INTERSECTION:
+			kernel_function = &Kernel::kernel_intersection;
+			break;
+		case CHI_SQUARED:
+			kernel_function = &Kernel::kernel_chi_squared;
+			break;
 	}
 
 	clone(x,x_,l);
@@ -283,32 +478,86 @@ Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
 	}
 	else
 		x_square = 0;
+
+	shared = NULL;
+	global = NULL;
+	if(param.kernel_cache != NULL && param.kernel_cache->accepts(param))
+	{
+		global = new int[l];
+		int i;
+		for(i=0;i<l && (global[i] = param.kernel_cache->index_of(x[i])) >= 0;i++)
+			;
+		if(i == l)
+			shared = param.kernel_cache;
+		else
+		{
+			delete[] global;
+			global = NULL;
+		}
+	}
 }
 
 Kernel::~Kernel()
 {
 	delete[] x;
 	delete[] x_square;
+	delete[] global;
 }
 
 double Kernel::dot(const svm_node *px, const svm_node *py)
 {
+	return additive_kernel<product_op>(px,py);
+}
+
+double Kernel::squared_distance(const svm_node *x, const svm_node *y)
+{
+	if(is_dense(x) && is_dense(y))
+	{
+		// rows of different lengths: the tail of the longer one is measured against zeros
+		if(dense_dim(x) < dense_dim(y))
+			swap(x,y);
+		int n = dense_dim(y);
+		const double *tail = dense_values(x)+n;
+		return dense_squared_distance(dense_values(x),dense_values(y),n)+additive<product_op>(tail,tail,dense_dim(x)-n);
+	}
+	if(is_dense(x) || is_dense(y))
+		return dot(x,x)+dot(y,y)-2*dot(x,y);
+
 	double sum = 0;
-	while(px->index != -1 && py->index != -1)
+	while(x->index != -1 && y->index !=-1)
 	{
-		if(px->index == py->index)
+		if(x->index == y->index)
 		{
-			sum += px->value * py->value;
-			++px;
-			++py;
+			double d = x->value - y->value;
+			sum += d*d;
+			++x;
+			++y;
 		}
 		else
 		{
-			if(px->index > py->index)
-				++py;
+			if(x->index > y->index)
+			{	
+				sum += y->value * y->value;
+				++y;
+			}
 			else
-				++px;
-		}			
+			{
+				sum += x->value * x->value;
+				++x;
+			}
+		}
+	}
+
+	while(x->index != -1)
+	{
+		sum += x->value * x->value;
+		++x;
+	}
+
+	while(y->index != -1)
+	{
+		sum += y->value * y->value;
+		++y;
 	}
 	return sum;
 }
@@ -323,55 +572,155 @@ double Kernel::k_function(const svm_node *x, const svm_node *y,
 		case POLY:
 			return powi(param.gamma*dot(x,y)+param.coef0,param.degree);
 		case RBF:
-		{
-			double sum = 0;
-			while(x->index != -1 && y->index !=-1)
-			{
-				if(x->index == y->index)
-				{
-					double d = x->value - y->value;
-					sum += d*d;
-					++x;
-					++y;
-				}
-				else
-				{
-					if(x->index > y->index)
-					{	
-						sum += y->value * y->value;
-						++y;
-					}
-					else
-					{
-						sum += x->value * x->value;
-						++x;
-					}
-				}
-			}
-
-			while(x->index != -1)
-			{
-				sum += x->value * x->value;
-				++x;
-			}
-
-			while(y->index != -1)
-			{
-				sum += y->value * y->value;
-				++y;
-			}
-			
-			return exp(-param.gamma*sum);
-		}
+			return exp(-param.gamma*squared_distance(x,y));
 		case SIGMOID:
 			return tanh(param.gamma*dot(x,y)+param.coef0);
 		case PRECOMPUTED:  //x: test (validation), y: SV
 			return x[(int)(y->value)].value;
+		case INTERSECTION:
+			return additive_kernel<min_op>(x,y);
+		case CHI_SQUARED:
+			return additive_kernel<chi_squared_op>(x,y);
 		default:
 			return 0;  // Unreachable 
 	}
 }
 
+// the subproblems' private caches come out of the same cache_size, so the shared rows get the rest
+svm_kernel_cache::svm_kernel_cache(const svm_problem *prob, const svm_parameter *param_)
+:l(prob->l), param(*param_), budget((size_t)(param_->cache_size*(1<<20)*(1-SHARED_CACHE_LOCAL_SHARE))), bytes(0), peak_bytes(0),
+ hits(0), misses(0), evictions(0)
+{
+	param.kernel_cache = NULL;
+	clone(x,prob->x,l);
+	if(param.kernel_type == RBF)
+	{
+		x_square = new double[l];
+		for(int i=0;i<l;i++)
+			x_square[i] = Kernel::dot(x[i],x[i]);
+	}
+	else
+		x_square = NULL;
+	index.reserve(l);
+	for(int i=0;i<l;i++)
+		index.insert(std::make_pair(x[i],i));
+	rows = new row_t[l];
+	for(int i=0;i<l;i++)
+	{
+		rows[i].prev = rows[i].next = NULL;
+		rows[i].data = NULL;
+		rows[i].pins = 0;
+	}
+	lru_head.next = lru_head.prev = &lru_head;
+}
+
+svm_kernel_cache::~svm_kernel_cache()
+{
+	for(int i=0;i<l;i++)
+		delete[] rows[i].data;
+	delete[] rows;
+	delete[] x;
+	delete[] x_square;
+}
+
+bool svm_kernel_cache::accepts(const svm_parameter& other) const
+{
+	return other.kernel_type == param.kernel_type && other.kernel_type != PRECOMPUTED &&
+		other.degree == param.degree && other.gamma == param.gamma && other.coef0 == param.coef0;
+}
+
+int svm_kernel_cache::index_of(const svm_node *p) const
+{
+	std::unordered_map<const svm_node *,int>::const_iterator it = index.find(p);
+	return it == index.end() ? -1 : it->second;
+}
+
+void svm_kernel_cache::lru_delete(row_t *r)
+{
+	r->prev->next = r->next;
+	r->next->prev = r->prev;
+}
+
+void svm_kernel_cache::lru_insert(row_t *r)
+{
+	r->next = &lru_head;
+	r->prev = lru_head.prev;
+	r->prev->next = r;
+	r->next->prev = r;
+}
+
+svm_kernel_cache::row_t *svm_kernel_cache::acquire(int a)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	row_t *r = &rows[a];
+	if(r->data == NULL)
+	{
+		size_t row_bytes = sizeof(std::atomic<Qfloat>)*l;
+		while(bytes + row_bytes > budget && lru_head.next != &lru_head)
+		{
+			row_t *old = lru_head.next;
+			lru_delete(old);
+			delete[] old->data;
+			old->data = NULL;
+			bytes -= row_bytes;
+			++evictions;
+		}
+		r->data = new std::atomic<Qfloat>[l];
+		for(int j=0;j<l;j++)
+			r->data[j].store(NAN,std::memory_order_relaxed);
+		bytes += row_bytes;
+		peak_bytes = max(peak_bytes,bytes);
+	}
+	else if(r->pins == 0)
+		lru_delete(r);
+	++r->pins;
+	return r;
+}
+
+void svm_kernel_cache::release(row_t *r)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if(--r->pins == 0)
+		lru_insert(r);
+}
+
+void svm_kernel_cache::get_row(int a, const int *global, Qfloat *data, int start, int len, int nr_thread)
+{
+	row_t *r = acquire(a);
+	const svm_node *xa = x[a];
+	unsigned long long computed = 0;
+	int j;
+#pragma omp parallel for private(j) schedule(guided) reduction(+:computed) num_threads(nr_thread) if(nr_thread > 1)
+	for(j=start;j<len;j++)
+	{
+		int b = global[j];
+		Qfloat v = r->data[b].load(std::memory_order_relaxed);
+		if(v != v)
+		{
+			if(x_square)
+				v = (Qfloat)exp(-param.gamma*(x_square[a]+x_square[b]-2*Kernel::dot(xa,x[b])));
+			else
+				v = (Qfloat)Kernel::k_function(xa,x[b],param);
+			r->data[b].store(v,std::memory_order_relaxed);
+			++computed;
+		}
+		data[j] = v;
+	}
+	release(r);
+	misses += computed;
+	hits += (unsigned long long)(len-start) - computed;
+}
+
+void svm_kernel_cache::get_stats(svm_kernel_cache_stats *stats)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	stats->hits = hits;
+	stats->misses = misses;
+	stats->evictions = evictions;
+	stats->bytes = bytes;
+	stats->peak_bytes = peak_bytes;
+}
+
 // An SMO algorithm in Fan et al., JMLR 6(2005), p. 1889--1918
 // Solves:
 //
@@ -421,6 +770,7 @@ protected:
 	int *active_set;
 	double *G_bar;		// gradient, if we treat free variables as 0
 	int l;
+	int nr_thread;	// threads for gradient updates, taken from Q
 	bool unshrink;	// XXX
 
 	double get_C(int i)
@@ -514,6 +864,7 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 	this->Cp = Cp;
 	this->Cn = Cn;
 	this->eps = eps;
+	nr_thread = Q.get_nr_thread();
 	unshrink = false;
 
 	// initialize alpha_status
@@ -547,6 +898,7 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 				const Qfloat *Q_i = Q.get_Q(i,l);
 				double alpha_i = alpha[i];
 				int j;
+#pragma omp parallel for private(j) schedule(static) num_threads(nr_thread) if(nr_thread > 1)
 				for(j=0;j<l;j++)
 					G[j] += alpha_i*Q_i[j];
 				if(is_upper_bound(i))
@@ -691,6 +1043,8 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		double delta_alpha_i = alpha[i] - old_alpha_i;
 		double delta_alpha_j = alpha[j] - old_alpha_j;
 		
+		// every G[k] is updated independently, so splitting the loop gives the same result as the serial one
+#pragma omp parallel for schedule(static) num_threads(nr_thread) if(nr_thread > 1 && active_size > PARALLEL_MIN_SIZE)
 		for(int k=0;k<active_size;k++)
 		{
 			G[k] += Q_i[k]*delta_alpha_i + Q_j[k]*delta_alpha_j;
@@ -1270,7 +1624,7 @@ public:
 	:Kernel(prob.l, prob.x, param)
 	{
 		clone(y,y_,prob.l);
-		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)));
+		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)*(shared ? SHARED_CACHE_LOCAL_SHARE : 1)));
 		QD = new double[prob.l];
 		for(int i=0;i<prob.l;i++)
 			QD[i] = (this->*kernel_function)(i,i);
@@ -1282,8 +1636,9 @@ public:
 		int start, j;
 		if((start = cache->get_data(i,&data,len)) < len)
 		{
+			kernel_row(i,data,start,len);
 			for(j=start;j<len;j++)
-				data[j] = (Qfloat)(y[i]*y[j]*(this->*kernel_function)(i,j));
+				data[j] *= y[i]*y[j];
 		}
 		return data;
 	}
@@ -1319,7 +1674,7 @@ public:
 	ONE_CLASS_Q(const svm_problem& prob, const svm_parameter& param)
 	:Kernel(prob.l, prob.x, param)
 	{
-		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)));
+		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)*(shared ? SHARED_CACHE_LOCAL_SHARE : 1)));
 		QD = new double[prob.l];
 		for(int i=0;i<prob.l;i++)
 			QD[i] = (this->*kernel_function)(i,i);
@@ -1328,12 +1683,9 @@ public:
 	Qfloat *get_Q(int i, int len) const
 	{
 		Qfloat *data;
-		int start, j;
+		int start;
 		if((start = cache->get_data(i,&data,len)) < len)
-		{
-			for(j=start;j<len;j++)
-				data[j] = (Qfloat)(this->*kernel_function)(i,j);
-		}
+			kernel_row(i,data,start,len);
 		return data;
 	}
 
@@ -1366,7 +1718,7 @@ public:
 	:Kernel(prob.l, prob.x, param)
 	{
 		l = prob.l;
-		cache = new Cache(l,(long int)(param.cache_size*(1<<20)));
+		cache = new Cache(l,(long int)(param.cache_size*(1<<20)*(shared ? SHARED_CACHE_LOCAL_SHARE : 1)));
 		QD = new double[2*l];
 		sign = new schar[2*l];
 		index = new int[2*l];
@@ -1396,10 +1748,7 @@ public:
 		Qfloat *data;
 		int j, real_i = index[i];
 		if(cache->get_data(real_i,&data,l) < l)
-		{
-			for(j=0;j<l;j++)
-				data[j] = (Qfloat)(this->*kernel_function)(real_i,j);
-		}
+			kernel_row(real_i,data,0,l);
 
 		// reorder and copy
 		Qfloat *buf = buffer[next_buffer];
@@ -1439,7 +1788,8 @@ private:
 //
 static void solve_c_svc(
 	const svm_problem *prob, const svm_parameter* param,
-	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn)
+	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn,
+	const double *alpha_init)
 {
 	int l = prob->l;
 	double *minus_ones = new double[l];
@@ -1449,7 +1799,7 @@ static void solve_c_svc(
 
 	for(i=0;i<l;i++)
 	{
-		alpha[i] = 0;
+		alpha[i] = alpha_init ? alpha_init[i] : 0;
 		minus_ones[i] = -1;
 		if(prob->y[i] > 0) y[i] = +1; else y[i] = -1;
 	}
@@ -1646,14 +1996,14 @@ struct decision_function
 
 static decision_function svm_train_one(
 	const svm_problem *prob, const svm_parameter *param,
-	double Cp, double Cn)
+	double Cp, double Cn, const double *alpha_init = NULL)
 {
 	double *alpha = Malloc(double,prob->l);
 	Solver::SolutionInfo si;
 	switch(param->svm_type)
 	{
 		case C_SVC:
-			solve_c_svc(prob,param,alpha,&si,Cp,Cn);
+			solve_c_svc(prob,param,alpha,&si,Cp,Cn,alpha_init);
 			break;
 		case NU_SVC:
 			solve_nu_svc(prob,param,alpha,&si);
@@ -2089,11 +2439,159 @@ static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **
 //
 // Interface functions
 //
+//
+// Warm start: the SVs of an earlier model are found among the training rows by pointer,
+// their alphas are scaled by the ratio of the C values and clipped to the new box
+//
+struct warm_start_info
+{
+	const svm_model *model;
+	double scale;
+	int *sv;		// warm SV index of each (grouped) training row, -1 if none
+	int *sv_class;		// warm class index of each warm SV
+	int *class_index;	// warm class index of each new class, -1 if the label is new
+};
+
+struct sv_pointer
+{
+	const svm_node *x;
+	int index;
+};
+
+static int compare_sv_pointer(const void *a, const void *b)
+{
+	const svm_node *x = ((const sv_pointer *)a)->x, *y = ((const sv_pointer *)b)->x;
+	return (x > y) - (x < y);
+}
+
+static bool warm_start_init(warm_start_info *w, const svm_model *warm, const svm_parameter *param,
+	svm_node **x, int l, const int *label, int nr_class)
+{
+	w->model = warm;
+	w->sv = NULL;
+	if(warm == NULL)
+		return false;
+	if(param->svm_type != C_SVC || warm->param.svm_type != C_SVC || warm->nSV == NULL)
+	{
+		info("warm start is only used for C-SVC, training from scratch\n");
+		return false;
+	}
+
+	int i;
+	w->scale = param->C/warm->param.C;
+	w->sv_class = Malloc(int,warm->l);
+	int k = 0;
+	for(i=0;i<warm->nr_class;i++)
+		for(int j=0;j<warm->nSV[i];j++)
+			w->sv_class[k++] = i;
+	w->class_index = Malloc(int,nr_class);
+	for(i=0;i<nr_class;i++)
+	{
+		w->class_index[i] = -1;
+		for(int j=0;j<warm->nr_class;j++)
+			if(warm->label[j] == label[i])
+				w->class_index[i] = j;
+	}
+
+	sv_pointer *sorted = Malloc(sv_pointer,warm->l);
+	for(i=0;i<warm->l;i++)
+	{
+		sorted[i].x = warm->SV[i];
+		sorted[i].index = i;
+	}
+	qsort(sorted,warm->l,sizeof(sv_pointer),compare_sv_pointer);
+	w->sv = Malloc(int,l);
+	for(i=0;i<l;i++)
+	{
+		sv_pointer key = { x[i], -1 };
+		sv_pointer *found = (sv_pointer *)bsearch(&key,sorted,warm->l,sizeof(sv_pointer),compare_sv_pointer);
+		w->sv[i] = found ? found->index : -1;
+	}
+	free(sorted);
+	return true;
+}
+
+static void warm_start_destroy(warm_start_info *w)
+{
+	if(w->sv == NULL)
+		return;
+	free(w->sv);
+	free(w->sv_class);
+	free(w->class_index);
+}
+
+// initial alphas of the pair (i,j), rows si..si+ci-1 are class i (y=+1) and sj..sj+cj-1 class j (y=-1)
+static double *warm_start_alpha(const warm_start_info *w, int i, int j, int si, int ci, int sj, int cj,
+	double Cp, double Cn)
+{
+	const svm_model *warm = w->model;
+	int wi = w->class_index[i], wj = w->class_index[j];
+	double *alpha = Malloc(double,ci+cj);
+	double sum_p = 0, sum_n = 0;
+	int k;
+	for(k=0;k<ci+cj;k++)
+	{
+		int row = k < ci ? si+k : sj+k-ci;
+		int wc = k < ci ? wi : wj, wo = k < ci ? wj : wi;
+		int sv = w->sv[row];
+		alpha[k] = 0;
+		if(sv < 0 || wc < 0 || wo < 0 || w->sv_class[sv] != wc)
+			continue;
+		double coef = warm->sv_coef[wc < wo ? wo-1 : wo][sv];
+		alpha[k] = min(fabs(coef)*w->scale, k < ci ? Cp : Cn);
+		if(k < ci)
+			sum_p += alpha[k];
+		else
+			sum_n += alpha[k];
+	}
+
+	// clipping or missing SVs can break sum y_i alpha_i = 0, shrink the heavier side to restore it
+	if(sum_p != sum_n)
+	{
+		double ratio = sum_p > sum_n ? sum_n/sum_p : sum_p/sum_n;
+		int begin = sum_p > sum_n ? 0 : ci, end = sum_p > sum_n ? ci : ci+cj;
+		for(k=begin;k<end;k++)
+			alpha[k] *= ratio;
+	}
+	return alpha;
+}
+
+static void report_kernel_cache(svm_kernel_cache *cache)
+{
+	svm_kernel_cache_stats stats;
+	cache->get_stats(&stats);
+	double total = (double)(stats.hits+stats.misses);
+	info("kernel cache: %llu hits, %llu misses (%.1f%% hits), %llu evictions, peak %.1f MB\n",
+		stats.hits,stats.misses,total > 0 ? 100.0*stats.hits/total : 0.0,stats.evictions,stats.peak_bytes/(double)(1<<20));
+}
+
+svm_kernel_cache *svm_create_kernel_cache(const svm_problem *prob, const svm_parameter *param)
+{
+	return new svm_kernel_cache(prob,param);
+}
+
+void svm_get_kernel_cache_stats(svm_kernel_cache *cache, svm_kernel_cache_stats *stats)
+{
+	cache->get_stats(stats);
+}
+
+void svm_destroy_kernel_cache(svm_kernel_cache *cache)
+{
+	delete cache;
+}
+
 svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
+{
+	return svm_train_warm(prob,param,NULL);
+}
+
+svm_model *svm_train_warm(const svm_problem *prob, const svm_parameter *param, const svm_model *warm)
 {
 	svm_model *model = Malloc(svm_model,1);
 	model->param = *param;
+	model->param.kernel_cache = NULL;
 	model->free_sv = 0;	// XXX
+	model->mapping = NULL;
 
 	if(param->svm_type == ONE_CLASS ||
 	   param->svm_type == EPSILON_SVR ||
@@ -2175,6 +2673,9 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 				weighted_C[j] *= param->weight[i];
 		}
 
+		warm_start_info warm_start;
+		bool use_warm_start = warm_start_init(&warm_start,warm,param,x,l,label,nr_class);
+
 		// train k*(k-1)/2 models
 		
 		bool *nonzero = Malloc(bool,l);
@@ -2189,43 +2690,101 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 			probB=Malloc(double,nr_class*(nr_class-1)/2);
 		}
 
+		int nr_pair = nr_class*(nr_class-1)/2;
+		int *pair_i = Malloc(int,nr_pair);
+		int *pair_j = Malloc(int,nr_pair);
 		int p = 0;
 		for(i=0;i<nr_class;i++)
 			for(int j=i+1;j<nr_class;j++)
 			{
-				svm_problem sub_prob;
-				int si = start[i], sj = start[j];
-				int ci = count[i], cj = count[j];
-				sub_prob.l = ci+cj;
-				sub_prob.x = Malloc(svm_node *,sub_prob.l);
-				sub_prob.y = Malloc(double,sub_prob.l);
-				int k;
-				for(k=0;k<ci;k++)
-				{
-					sub_prob.x[k] = x[si+k];
-					sub_prob.y[k] = +1;
-				}
-				for(k=0;k<cj;k++)
-				{
-					sub_prob.x[ci+k] = x[sj+k];
-					sub_prob.y[ci+k] = -1;
-				}
+				pair_i[p] = i;
+				pair_j[p] = j;
+				++p;
+			}
 
-				if(param->probability)
-					svm_binary_svc_probability(&sub_prob,param,weighted_C[i],weighted_C[j],probA[p],probB[p]);
+		// pairs are independent, solve them concurrently with the cache budget split between them;
+		// probability estimates draw from rand() so they keep the sequential order
+		int nr_concurrent = param->probability ? 1 : min(param->nr_thread,nr_pair);
+		svm_parameter pair_param = *param;
+		if(nr_concurrent > 1)
+		{
+			pair_param.nr_thread = 1;
+			pair_param.cache_size = param->cache_size/nr_concurrent;
+		}
 
-				f[p] = svm_train_one(&sub_prob,param,weighted_C[i],weighted_C[j]);
-				for(k=0;k<ci;k++)
-					if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
-						nonzero[si+k] = true;
-				for(k=0;k<cj;k++)
-					if(!nonzero[sj+k] && fabs(f[p].alpha[ci+k]) > 0)
-						nonzero[sj+k] = true;
-				free(sub_prob.x);
-				free(sub_prob.y);
-				++p;
+		// a sample is in the nr_class-1 pairs of its class, they share its kernel values
+		svm_kernel_cache *own_cache = NULL;
+		if(param->kernel_cache == NULL && nr_pair > 1 && param->kernel_type != PRECOMPUTED)
+			pair_param.kernel_cache = own_cache = new svm_kernel_cache(prob,param);
+
+		// largest subproblems first, so the last ones handed out are short
+		int *order = Malloc(int,nr_pair);
+		for(p=0;p<nr_pair;p++)
+		{
+			int size = count[pair_i[p]]+count[pair_j[p]];
+			int q = p;
+			for(;q>0 && count[pair_i[order[q-1]]]+count[pair_j[order[q-1]]] < size;q--)
+				order[q] = order[q-1];
+			order[q] = p;
+		}
+
+#pragma omp parallel for schedule(dynamic,1) num_threads(nr_concurrent) if(nr_concurrent > 1)
+		for(int q=0;q<nr_pair;q++)
+		{
+			int p = order[q];
+			int i = pair_i[p], j = pair_j[p];
+			svm_problem sub_prob;
+			int si = start[i], sj = start[j];
+			int ci = count[i], cj = count[j];
+			sub_prob.l = ci+cj;
+			sub_prob.x = Malloc(svm_node *,sub_prob.l);
+			sub_prob.y = Malloc(double,sub_prob.l);
+			int k;
+			for(k=0;k<ci;k++)
+			{
+				sub_prob.x[k] = x[si+k];
+				sub_prob.y[k] = +1;
+			}
+			for(k=0;k<cj;k++)
+			{
+				sub_prob.x[ci+k] = x[sj+k];
+				sub_prob.y[ci+k] = -1;
 			}
 
+			if(param->probability)
+				svm_binary_svc_probability(&sub_prob,&pair_param,weighted_C[i],weighted_C[j],probA[p],probB[p]);
+
+			double *alpha_init = NULL;
+			if(use_warm_start)
+				alpha_init = warm_start_alpha(&warm_start,i,j,si,ci,sj,cj,weighted_C[i],weighted_C[j]);
+
+			f[p] = svm_train_one(&sub_prob,&pair_param,weighted_C[i],weighted_C[j],alpha_init);
+			free(alpha_init);
+			free(sub_prob.x);
+			free(sub_prob.y);
+		}
+		warm_start_destroy(&warm_start);
+		if(own_cache)
+		{
+			report_kernel_cache(own_cache);
+			delete own_cache;
+		}
+
+		for(p=0;p<nr_pair;p++)
+		{
+			int si = start[pair_i[p]], sj = start[pair_j[p]];
+			int ci = count[pair_i[p]], cj = count[pair_j[p]];
+			for(int k=0;k<ci;k++)
+				if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
+					nonzero[si+k] = true;
+			for(int k=0;k<cj;k++)
+				if(!nonzero[sj+k] && fabs(f[p].alpha[ci+k]) > 0)
+					nonzero[sj+k] = true;
+		}
+		free(pair_i);
+		free(pair_j);
+		free(order);
+
 		// build output
 
 		model->nr_class = nr_class;
@@ -2412,6 +2971,23 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 			fold_start[i]=i*l/nr_fold;
 	}
 
+	// folds are independent, train them concurrently with the cache budget split between them;
+	// probability estimates draw from rand() so they keep the sequential order
+	int nr_concurrent = param->probability ? 1 : min(param->nr_thread,nr_fold);
+	svm_parameter fold_param = *param;
+	if(nr_concurrent > 1)
+	{
+		fold_param.nr_thread = 1;
+		fold_param.cache_size = param->cache_size/nr_concurrent;
+	}
+
+	// a sample is in the training set of nr_fold-1 folds, concurrent ones share its kernel values,
+	// sequential folds keep the private caches of a plain svm_train
+	svm_kernel_cache *own_cache = NULL;
+	if(param->kernel_cache == NULL && nr_concurrent > 1 && param->kernel_type != PRECOMPUTED)
+		fold_param.kernel_cache = own_cache = new svm_kernel_cache(prob,param);
+
+#pragma omp parallel for schedule(dynamic,1) num_threads(nr_concurrent) if(nr_concurrent > 1)
 	for(i=0;i<nr_fold;i++)
 	{
 		int begin = fold_start[i];
@@ -2436,7 +3012,7 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 			subprob.y[k] = prob->y[perm[j]];
 			++k;
 		}
-		struct svm_model *submodel = svm_train(&subprob,param);
+		struct svm_model *submodel = svm_train(&subprob,&fold_param);
 		if(param->probability && 
 		   (param->svm_type == C_SVC || param->svm_type == NU_SVC))
 		{
@@ -2452,6 +3028,11 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 		free(subprob.x);
 		free(subprob.y);
 	}		
+	if(own_cache)
+	{
+		report_kernel_cache(own_cache);
+		delete own_cache;
+	}
 	free(fold_start);
 	free(perm);	
 }
@@ -2635,7 +3216,7 @@ static const char *svm_type_table[] =
 
 static const char *kernel_type_table[]=
 {
-	"linear","polynomial","rbf","sigmoid","precomputed",NULL
+	"linear","polynomial","rbf","sigmoid","precomputed","intersection","chi_squared",NULL
 };
 
 int svm_save_model(const char *model_file_name, const svm_model *model)
@@ -2716,6 +3297,14 @@ int svm_save_model(const char *model_file_name, const svm_model *model)
 
 		if(param.kernel_type == PRECOMPUTED)
 			fprintf(fp,"0:%d ",(int)(p->value));
+		else if(is_dense(p))
+		{
+			// dense SVs are written sparsely, so the file stays readable by plain libsvm
+			const double *v = dense_values(p);
+			for(int k=0;k<dense_dim(p);k++)
+				if(v[k] != 0)
+					fprintf(fp,"%d:%.8g ",k+1,v[k]);
+		}
 		else
 			while(p->index != -1)
 			{
@@ -2755,6 +3344,9 @@ static char* readline(FILE *input)
 
 svm_model *svm_load_model(const char *model_file_name)
 {
+	if(svm_is_binary_model(model_file_name))
+		return svm_load_model_binary(model_file_name);
+
 	FILE *fp = fopen(model_file_name,"rb");
 	if(fp==NULL) return NULL;
 
@@ -2765,6 +3357,8 @@ svm_model *svm_load_model(const char *model_file_name)
 
 	svm_model *model = Malloc(svm_model,1);
 	svm_parameter& param = model->param;
+	param.nr_thread = 1;
+	param.kernel_cache = NULL;
 	model->rho = NULL;
 	model->probA = NULL;
 	model->probB = NULL;
@@ -2966,11 +3560,319 @@ svm_model *svm_load_model(const char *model_file_name)
 		return NULL;
 
 	model->free_sv = 1;	// XXX
+	model->mapping = NULL;
+	return model;
+}
+
+//
+// Binary model format
+//
+// header, then rho, probA, probB, label, nSV, sv_indices, sv_coef rows and the SVs, each array at a
+// 32-byte boundary; SVs are dense rows laid out as by svm_alloc_dense (precomputed models keep their
+// two-node 0:id rows), so a mapped file is used in place
+//
+static const char binary_model_magic[8] = {'L','D','B','O','F','S','V','M'};
+#define BINARY_MODEL_VERSION 1
+#define BINARY_MODEL_MAX_CLASS 32768	// keeps nr_class*(nr_class-1)/2 in an int
+
+enum { BINARY_PROB_A = 1, BINARY_PROB_B = 2, BINARY_CLASSES = 4, BINARY_SV_INDICES = 8 };
+
+struct binary_model_header
+{
+	char magic[8];
+	int version;
+	int svm_type;
+	int kernel_type;
+	int degree;
+	double gamma;
+	double coef0;
+	int nr_class;
+	int l;
+	int dim;
+	int flags;
+	long long size;		// whole file, checked against the mapping
+	char reserved[64];
+};
+
+enum { SECTION_RHO, SECTION_PROB_A, SECTION_PROB_B, SECTION_LABEL, SECTION_NSV, SECTION_SV_INDICES,
+	SECTION_SV_COEF, SECTION_SV, SECTION_END };
+
+static size_t align_up(size_t n)
+{
+	return (n + DENSE_ALIGN-1)/DENSE_ALIGN*DENSE_ALIGN;
+}
+
+static size_t binary_sv_stride(const binary_model_header *h)
+{
+	if(h->kernel_type == PRECOMPUTED)
+		return 2*sizeof(svm_node);
+	return DENSE_ALIGN + align_up(sizeof(double)*h->dim);
+}
+
+// count*elem bytes, false if that is more than limit
+static bool section_bytes(size_t count, size_t elem, size_t limit, size_t *bytes)
+{
+	if(elem != 0 && count > limit/elem)
+		return false;
+	*bytes = count*elem;
+	return true;
+}
+
+// offsets of the sections, false if the file they describe would exceed limit bytes;
+// nr_class and l must be in range, every product is checked before it is formed
+static bool binary_model_layout(const binary_model_header *h, size_t *offset, size_t limit)
+{
+	size_t nr_class = h->nr_class, l = h->l;
+	size_t nr_rho = nr_class*(nr_class-1)/2;
+	size_t size[SECTION_END];
+	bool ok = section_bytes(nr_rho,sizeof(double),limit,&size[SECTION_RHO]);
+	size[SECTION_PROB_A] = (h->flags & BINARY_PROB_A) ? size[SECTION_RHO] : 0;
+	size[SECTION_PROB_B] = (h->flags & BINARY_PROB_B) ? size[SECTION_RHO] : 0;
+	size[SECTION_LABEL] = (h->flags & BINARY_CLASSES) ? sizeof(int)*nr_class : 0;
+	size[SECTION_NSV] = size[SECTION_LABEL];
+	ok = ok && section_bytes((h->flags & BINARY_SV_INDICES) ? l : 0,sizeof(int),limit,&size[SECTION_SV_INDICES]);
+	ok = ok && section_bytes((nr_class-1)*l,sizeof(double),limit,&size[SECTION_SV_COEF]);
+	ok = ok && (h->kernel_type == PRECOMPUTED || (size_t)h->dim <= limit/sizeof(double));
+	ok = ok && section_bytes(l,binary_sv_stride(h),limit,&size[SECTION_SV]);
+	if(!ok)
+		return false;
+
+	offset[0] = align_up(sizeof(binary_model_header));
+	for(int i=0;i<SECTION_END;i++)
+	{
+		if(size[i] > limit - offset[i])
+			return false;
+		offset[i+1] = align_up(offset[i] + size[i]);
+	}
+	return offset[SECTION_END] <= limit;
+}
+
+static bool write_section(FILE *fp, size_t offset, const void *data, size_t size)
+{
+	static const char zeros[DENSE_ALIGN] = {0};
+	long position = ftell(fp);
+	if(position < 0 || (size_t)position > offset)
+		return false;
+	if(fwrite(zeros,1,offset-position,fp) != offset-position)
+		return false;
+	return size == 0 || fwrite(data,1,size,fp) == size;
+}
+
+int svm_save_model_binary(const char *model_file_name, const svm_model *model)
+{
+	FILE *fp = fopen(model_file_name,"wb");
+	if(fp==NULL) return -1;
+
+	const svm_parameter& param = model->param;
+	int i;
+
+	binary_model_header h;
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,binary_model_magic,sizeof(h.magic));
+	h.version = BINARY_MODEL_VERSION;
+	h.svm_type = param.svm_type;
+	h.kernel_type = param.kernel_type;
+	h.degree = param.degree;
+	h.gamma = param.gamma;
+	h.coef0 = param.coef0;
+	h.nr_class = model->nr_class;
+	h.l = model->l;
+	h.flags = (model->probA ? BINARY_PROB_A : 0) | (model->probB ? BINARY_PROB_B : 0) |
+		(model->label && model->nSV ? BINARY_CLASSES : 0) | (model->sv_indices ? BINARY_SV_INDICES : 0);
+
+	// the widest SV sets the row length, shorter and sparse rows are zero filled
+	h.dim = 0;
+	if(param.kernel_type != PRECOMPUTED)
+		for(i=0;i<model->l;i++)
+		{
+			const svm_node *p = model->SV[i];
+			if(is_dense(p))
+				h.dim = max(h.dim,dense_dim(p));
+			else
+				for(;p->index != -1;p++)
+					h.dim = max(h.dim,p->index);
+		}
+
+	size_t offset[SECTION_END+1];
+	if(!binary_model_layout(&h,offset,(size_t)LLONG_MAX))
+	{
+		fclose(fp);
+		return -1;
+	}
+	h.size = offset[SECTION_END];
+
+	int nr_rho = model->nr_class*(model->nr_class-1)/2;
+	bool ok = fwrite(&h,sizeof(h),1,fp) == 1;
+	ok = ok && write_section(fp,offset[SECTION_RHO],model->rho,sizeof(double)*nr_rho);
+	if(h.flags & BINARY_PROB_A)
+		ok = ok && write_section(fp,offset[SECTION_PROB_A],model->probA,sizeof(double)*nr_rho);
+	if(h.flags & BINARY_PROB_B)
+		ok = ok && write_section(fp,offset[SECTION_PROB_B],model->probB,sizeof(double)*nr_rho);
+	if(h.flags & BINARY_CLASSES)
+	{
+		ok = ok && write_section(fp,offset[SECTION_LABEL],model->label,sizeof(int)*model->nr_class);
+		ok = ok && write_section(fp,offset[SECTION_NSV],model->nSV,sizeof(int)*model->nr_class);
+	}
+	if(h.flags & BINARY_SV_INDICES)
+		ok = ok && write_section(fp,offset[SECTION_SV_INDICES],model->sv_indices,sizeof(int)*model->l);
+	for(i=0;i<model->nr_class-1;i++)
+		ok = ok && write_section(fp,offset[SECTION_SV_COEF]+sizeof(double)*(size_t)i*model->l,model->sv_coef[i],sizeof(double)*model->l);
+
+	size_t stride = binary_sv_stride(&h);
+	char *row = (char *)calloc(stride,1);
+	svm_node *node = (svm_node *)(row + (param.kernel_type == PRECOMPUTED ? 0 : DENSE_ALIGN - sizeof(svm_node)));
+	double *values = (double *)(node+1);
+	for(i=0;i<model->l && ok;i++)
+	{
+		const svm_node *p = model->SV[i];
+		if(param.kernel_type == PRECOMPUTED)
+		{
+			node[0] = p[0];
+			node[1].index = -1;
+			node[1].value = 0;
+		}
+		else
+		{
+			node->index = SVM_DENSE_ROW;
+			node->value = h.dim;
+			memset(values,0,sizeof(double)*h.dim);
+			if(is_dense(p))
+				memcpy(values,dense_values(p),sizeof(double)*dense_dim(p));
+			else
+				for(;p->index != -1;p++)
+					values[p->index-1] = p->value;
+		}
+		ok = write_section(fp,offset[SECTION_SV]+stride*i,row,stride);
+	}
+	free(row);
+	ok = ok && write_section(fp,offset[SECTION_END],NULL,0);
+
+	if (ferror(fp) != 0 || fclose(fp) != 0 || !ok) return -1;
+	return 0;
+}
+
+int svm_is_binary_model(const char *model_file_name)
+{
+	FILE *fp = fopen(model_file_name,"rb");
+	if(fp==NULL) return 0;
+	char magic[sizeof(binary_model_magic)];
+	int binary = fread(magic,sizeof(magic),1,fp) == 1 && memcmp(magic,binary_model_magic,sizeof(magic)) == 0;
+	fclose(fp);
+	return binary;
+}
+
+svm_model *svm_load_model_binary(const char *model_file_name)
+{
+	int fd = open(model_file_name,O_RDONLY);
+	if(fd < 0) return NULL;
+	struct stat st;
+	if(fstat(fd,&st) != 0 || (size_t)st.st_size < sizeof(binary_model_header))
+	{
+		close(fd);
+		return NULL;
+	}
+	size_t size = st.st_size;
+	// private and writable like an allocated model, pages are only copied if someone writes to them
+	void *mapping = mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+	close(fd);
+	if(mapping == MAP_FAILED) return NULL;
+
+	char *base = (char *)mapping;
+	const binary_model_header *h = (const binary_model_header *)base;
+	size_t offset[SECTION_END+1];
+	bool valid = memcmp(h->magic,binary_model_magic,sizeof(h->magic)) == 0 && h->version == BINARY_MODEL_VERSION &&
+		h->svm_type >= C_SVC && h->svm_type <= NU_SVR && h->kernel_type >= LINEAR && h->kernel_type <= CHI_SQUARED &&
+		h->nr_class >= 1 && h->nr_class <= BINARY_MODEL_MAX_CLASS && h->l >= 0 && h->dim >= 0;
+	valid = valid && binary_model_layout(h,offset,size) && offset[SECTION_END] == size && h->size == (long long)size;
+
+	// prediction walks nSV over the SVs and reads each row to its header's length, so both must agree with l and dim
+	if(valid && (h->svm_type == C_SVC || h->svm_type == NU_SVC))
+		valid = (h->flags & BINARY_CLASSES) != 0;
+	if(valid && (h->flags & BINARY_CLASSES))
+	{
+		const int *nSV = (const int *)(base + offset[SECTION_NSV]);
+		long long total = 0;
+		for(int c=0;c<h->nr_class && valid;c++)
+		{
+			valid = nSV[c] >= 0;
+			total += nSV[c];
+		}
+		valid = valid && total == h->l;
+	}
+	size_t stride = valid ? binary_sv_stride(h) : 0;
+	for(int i=0;i<h->l && valid;i++)
+	{
+		const svm_node *row = (const svm_node *)(base + offset[SECTION_SV] + stride*i);
+		if(h->kernel_type == PRECOMPUTED)
+			valid = row[1].index == -1;
+		else
+		{
+			row = (const svm_node *)((const char *)row + DENSE_ALIGN - sizeof(svm_node));
+			valid = row->index == SVM_DENSE_ROW && row->value == h->dim;
+		}
+	}
+	if(!valid)
+	{
+		fprintf(stderr,"%s is not a valid version %d binary model or is truncated\n",model_file_name,BINARY_MODEL_VERSION);
+		munmap(mapping,size);
+		return NULL;
+	}
+
+	svm_model *model = Malloc(svm_model,1);
+	svm_parameter& param = model->param;
+	memset(&param,0,sizeof(param));
+	param.nr_thread = 1;
+	param.svm_type = h->svm_type;
+	param.kernel_type = h->kernel_type;
+	param.degree = h->degree;
+	param.gamma = h->gamma;
+	param.coef0 = h->coef0;
+
+	model->nr_class = h->nr_class;
+	model->l = h->l;
+	model->rho = (double *)(base + offset[SECTION_RHO]);
+	model->probA = (h->flags & BINARY_PROB_A) ? (double *)(base + offset[SECTION_PROB_A]) : NULL;
+	model->probB = (h->flags & BINARY_PROB_B) ? (double *)(base + offset[SECTION_PROB_B]) : NULL;
+	model->label = (h->flags & BINARY_CLASSES) ? (int *)(base + offset[SECTION_LABEL]) : NULL;
+	model->nSV = (h->flags & BINARY_CLASSES) ? (int *)(base + offset[SECTION_NSV]) : NULL;
+	model->sv_indices = (h->flags & BINARY_SV_INDICES) ? (int *)(base + offset[SECTION_SV_INDICES]) : NULL;
+
+	int i;
+	model->sv_coef = Malloc(double *,model->nr_class-1);
+	for(i=0;i<model->nr_class-1;i++)
+		model->sv_coef[i] = (double *)(base + offset[SECTION_SV_COEF]) + (size_t)i*model->l;
+
+	size_t header_offset = param.kernel_type == PRECOMPUTED ? 0 : DENSE_ALIGN - sizeof(svm_node);
+	model->SV = Malloc(svm_node *,model->l);
+	for(i=0;i<model->l;i++)
+		model->SV[i] = (svm_node *)(base + offset[SECTION_SV] + stride*i + header_offset);
+
+	model->free_sv = 2;
+	model->mapping = mapping;
+	model->mapping_size = size;
 	return model;
 }
 
 void svm_free_model_content(svm_model* model_ptr)
 {
+	if(model_ptr->free_sv == 2)
+	{
+		// only the pointer arrays were allocated, everything else lives in the mapping
+		free(model_ptr->SV);
+		free(model_ptr->sv_coef);
+		munmap(model_ptr->mapping,model_ptr->mapping_size);
+		model_ptr->SV = NULL;
+		model_ptr->sv_coef = NULL;
+		model_ptr->rho = NULL;
+		model_ptr->label = NULL;
+		model_ptr->probA = NULL;
+		model_ptr->probB = NULL;
+		model_ptr->sv_indices = NULL;
+		model_ptr->nSV = NULL;
+		model_ptr->mapping = NULL;
+		return;
+	}
+
 	if(model_ptr->free_sv && model_ptr->l > 0 && model_ptr->SV != NULL)
 		free((void *)(model_ptr->SV[0]));
 	if(model_ptr->sv_coef)
@@ -3039,9 +3941,14 @@ const char *svm_check_parameter(const svm_problem *prob, const svm_parameter *pa
 	   kernel_type != POLY &&
 	   kernel_type != RBF &&
 	   kernel_type != SIGMOID &&
-	   kernel_type != PRECOMPUTED)
+	   kernel_type != PRECOMPUTED &&
+	   kernel_type != INTERSECTION &&
+	   kernel_type != CHI_SQUARED)
 		return "unknown kernel type";
 
+	if(kernel_type == PRECOMPUTED && prob->l > 0 && is_dense(prob->x[0]))
+		return "precomputed kernel needs sparse rows";
+
 	if(param->gamma < 0)
 		return "gamma < 0";
 
@@ -3053,6 +3960,9 @@ const char *svm_check_parameter(const svm_problem *prob, const svm_parameter *pa
 	if(param->cache_size <= 0)
 		return "cache_size <= 0";
 
+	if(param->nr_thread < 1)
+		return "nr_thread < 1";
+
 	if(param->eps <= 0)
 		return "eps <= 0";
 
@@ -3149,6 +4059,11 @@ int svm_check_probability_model(const svm_model *model)
 		 model->probA!=NULL);
 }
 
+double svm_kernel_value(const svm_node *x, const svm_node *y, const svm_parameter *param)
+{
+	return Kernel::k_function(x,y,*param);
+}
+
 void svm_set_print_string_function(void (*print_func)(const char *))
 {
 	if(print_func == NULL)
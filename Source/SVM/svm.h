@@ -3,6 +3,8 @@
 
 #define LIBSVM_VERSION 317
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -15,6 +17,13 @@ struct svm_node
 	double value;
 };
 
+/*
+ * dense rows: x->index == SVM_DENSE_ROW and x->value holds the dimension, the
+ * values follow the node as a contiguous 32-byte aligned double array
+ * (see svm_alloc_dense), sparse and dense rows can be mixed
+ */
+#define SVM_DENSE_ROW -2
+
 struct svm_problem
 {
 	int l;
@@ -23,7 +32,7 @@ struct svm_problem
 };
 
 enum { C_SVC, NU_SVC, ONE_CLASS, EPSILON_SVR, NU_SVR };	/* svm_type */
-enum { LINEAR, POLY, RBF, SIGMOID, PRECOMPUTED }; /* kernel_type */
+enum { LINEAR, POLY, RBF, SIGMOID, PRECOMPUTED, INTERSECTION, CHI_SQUARED }; /* kernel_type */
 
 struct svm_parameter
 {
@@ -44,6 +53,8 @@ struct svm_parameter
 	double p;	/* for EPSILON_SVR */
 	int shrinking;	/* use the shrinking heuristics */
 	int probability; /* do probability estimates */
+	int nr_thread;	/* threads for kernel columns and gradient updates, 1 is serial */
+	struct svm_kernel_cache *kernel_cache;	/* shared kernel cache (see below), NULL for one per call */
 };
 
 //
@@ -69,14 +80,54 @@ struct svm_model
 	/* XXX */
 	int free_sv;		/* 1 if svm_model is created by svm_load_model*/
 				/* 0 if svm_model is created by svm_train */
+				/* 2 if svm_model is mapped from a binary model file */
+	void *mapping;		/* the file mapping the arrays of a binary model point into */
+	size_t mapping_size;
 };
 
 struct svm_model *svm_train(const struct svm_problem *prob, const struct svm_parameter *param);
+/*
+ * C-SVC started from the alphas of an earlier model (scaled by C/warm C), e.g. the previous point of a C
+ * path or a model extended with new samples; warm SVs are matched by pointer among prob->x, so warm must
+ * have been trained on rows shared with prob, other rows start from zero
+ */
+struct svm_model *svm_train_warm(const struct svm_problem *prob, const struct svm_parameter *param, const struct svm_model *warm);
 void svm_cross_validation(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, double *target);
 
+/*
+ * kernel cache shared by subproblems: rows are the samples of prob, recognized by pointer, so the
+ * one-vs-one pairs of svm_train and the folds of svm_cross_validation all read and fill the same
+ * K(a,b) values, safely from concurrent threads; param->cache_size bounds the shared rows together with
+ * the subproblems' small private caches, concurrent callers split it between them as svm_train does
+ * both calls create one for themselves (multi-class, or cross validation with concurrent folds) when
+ * param->kernel_cache is NULL and report its counters; set it to share one across calls on rows of the same problem
+ * with the same kernel, other subproblems keep a private cache
+ */
+struct svm_kernel_cache;
+struct svm_kernel_cache_stats
+{
+	unsigned long long hits;	/* kernel values read from the cache */
+	unsigned long long misses;	/* kernel values computed */
+	unsigned long long evictions;	/* rows dropped to stay within the budget */
+	size_t bytes;			/* held by rows now */
+	size_t peak_bytes;
+};
+struct svm_kernel_cache *svm_create_kernel_cache(const struct svm_problem *prob, const struct svm_parameter *param);
+void svm_get_kernel_cache_stats(struct svm_kernel_cache *cache, struct svm_kernel_cache_stats *stats);
+void svm_destroy_kernel_cache(struct svm_kernel_cache *cache);
+
 int svm_save_model(const char *model_file_name, const struct svm_model *model);
 struct svm_model *svm_load_model(const char *model_file_name);
 
+/*
+ * binary models: a versioned header followed by 32-byte aligned arrays, the SVs as one matrix of dense
+ * rows (see SVM_DENSE_ROW); loading maps the file and points the model into it without parsing
+ * svm_load_model reads either format
+ */
+int svm_save_model_binary(const char *model_file_name, const struct svm_model *model);
+struct svm_model *svm_load_model_binary(const char *model_file_name);
+int svm_is_binary_model(const char *model_file_name);
+
 int svm_get_svm_type(const struct svm_model *model);
 int svm_get_nr_class(const struct svm_model *model);
 void svm_get_labels(const struct svm_model *model, int *label);
@@ -96,6 +147,11 @@ const char *svm_check_parameter(const struct svm_problem *prob, const struct svm
 int svm_check_probability_model(const struct svm_model *model);
 
 void svm_set_print_string_function(void (*print_func)(const char *));
+double svm_kernel_value(const struct svm_node *x, const struct svm_node *y, const struct svm_parameter *param);
+
+struct svm_node **svm_alloc_dense(int l, int dim);
+double *svm_dense_values(struct svm_node *x);
+void svm_free_dense(struct svm_node **x);
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,7 @@
 #include <sstream>
 #include <string>
 #include "BagOfFeatures/Codewords.hpp"
+#include "FeatureMap/FeatureMap.hpp"
 #include "Quantization/HardAssignment.hpp"
 #include "Quantization/CodewordUncertainty.hpp"
 #include "Quantization/Quantization.hpp"
@@ -35,6 +36,9 @@ int main(int argc, char **argv){
     int dataset_size = 676; //676 for graz2 train, 400 for graz2 validation and test
     int positive_category = 0; //the category we are training for
     //for graz2, 0 - bikes, 1 - cars, 2 - background, 3 - people
+    std::string feature_map_type = "none"; //"additive" or "fourier" writes mapped histograms, as TrainSVM -m trains on them
+    HistogramKernel feature_map_kernel = IntersectionKernel; //TrainSVM -k, for the additive map
+    double feature_map_gamma = 1; //TrainSVM -g, for the fourier map
 
     //Load training images
     std::cout << "Load Training Images" << std::endl;
@@ -50,7 +54,7 @@ int main(int argc, char **argv){
     svm_problem prob;
     prob.l = dataset_size;
     prob.y = new double[dataset_size];
-    prob.x = new svm_node*[dataset_size];
+    prob.x = svm_alloc_dense(dataset_size, histogram_size); //one contiguous row per image
 
     int index = 0;
     //a. compute histograms for images
@@ -70,21 +74,41 @@ int main(int argc, char **argv){
                 prob.y[index] = -1;
             }
 
-            svm_node *hist = new svm_node[histogram_size]; //hist size is number of words in vocabulary
+            double *hist = svm_dense_values(prob.x[index]); //hist size is number of words in vocabulary
             for(int k = 0; k < histogram_size; k++){
-                svm_node item;
-                item.index = k+1;
-                item.value = feature_space_vectors[j][k];
-                hist[k] = item;
+                hist[k] = feature_space_vectors[j][k];
             }
-            prob.x[index] = hist;
             index++;
         }
     }
 
+    //map the histograms with the same map TrainSVM used, its linear models predict on the mapped rows
+    int row_size = histogram_size;
+    cv::Ptr<FeatureMap> feature_map = FeatureMap::create(feature_map_type, feature_map_kernel, histogram_size, feature_map_gamma);
+    if(!feature_map.empty()){
+        cv::Mat histograms(prob.l, histogram_size, CV_64F);
+        for(int i = 0; i < prob.l; i++){
+            const double *hist = svm_dense_values(prob.x[i]);
+            std::copy(hist, hist + histogram_size, histograms.ptr<double>(i));
+        }
+        cv::Mat features;
+        feature_map->map(histograms, features);
+
+        row_size = features.cols;
+        svm_node **mapped = svm_alloc_dense(prob.l, row_size);
+        for(int i = 0; i < prob.l; i++){
+            const float *z = features.ptr<float>(i);
+            std::copy(z, z + row_size, svm_dense_values(mapped[i]));
+        }
+        svm_free_dense(prob.x);
+        prob.x = mapped;
+    }
+
     //write problem to file
-    save_problem(train_filename, prob, histogram_size);
+    save_problem(train_filename, prob, row_size);
 
+    svm_free_dense(prob.x);
+    delete[] prob.y;
     return 0;
 }
 
@@ -93,8 +117,9 @@ void save_problem(std::string filename, const svm_problem &prob, int codebook_si
     std::ofstream fileout (filename);
     for(int i = 0; i < prob.l; i++){
         fileout << prob.y[i] << " ";
+        const double *hist = svm_dense_values(prob.x[i]);
         for(int j = 0; j < codebook_size; j++){
-            fileout << prob.x[i][j].index << ":" << prob.x[i][j].value << " ";
+            fileout << j+1 << ":" << hist[j] << " ";
         }
         fileout << std::endl;
     }
@@ -113,7 +138,9 @@ void compute_bow_histograms(std::vector<cv::Mat> &samples, std::vector<Histogram
     //Load codebook
     std::cout << "Load Codebook" << std::endl;
     std::vector<std::vector<double>> codebook;
-    LoadCodebook(codebook_filename, codebook);
+    if(!LoadCodebook(codebook_filename, codebook)){
+        return;
+    }
 
     cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create(detector_type);
     if(detector_type.compare("Dense") == 0){
@@ -0,0 +1,357 @@
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc/types_c.h>
+#include <opencv2/highgui/highgui_c.h>
+#include <opencv2/nonfree/nonfree.hpp>
+#include <opencv2/nonfree/features2d.hpp>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "BagOfFeatures/Codewords.hpp"
+#include "FeatureMap/FeatureMap.hpp"
+#include "Quantization/HardAssignment.hpp"
+#include "Quantization/CodewordUncertainty.hpp"
+#include "Quantization/Quantization.hpp"
+#include "SVM/svm.h"
+#include "SVM/GramMatrix.hpp"
+#include "SVM/LinearSVM.hpp"
+#include "SVM/Problem.hpp"
+#include "Util/Datasets.hpp"
+#include "Util/Types.hpp"
+
+using std::vector;
+using namespace LocalDescriptorAndBagOfFeature;
+
+bool build_problem(svm_problem &prob, const std::string &codebook_filename, const std::string &detector_type, const std::string &quantization_type);
+void compute_bow_histogram(const cv::Mat &sample, Histogram &feature_vector, cv::Ptr<cv::FeatureDetector> &detector, cv::SiftDescriptorExtractor &extractor, Quantization *quant);
+int train_mapped(const svm_problem &prob, const FeatureMap &feature_map, double C, const std::string &model_prefix, bool binary_models);
+
+//trains one-vs-rest SVMs for every category in one process: the histograms go into one dense arena, the kernel
+//matrix is computed once and shared by all categories, which train in parallel, and the models are written directly
+//with -p the histograms are read from a binary problem file, or written to it when it doesn't exist yet
+//with -m the histograms go through an explicit feature map (additive for the -k kernel, or random Fourier features
+//for RBF with -g gamma) and train a linear SVM instead, see train_mapped
+int main(int argc, char **argv){
+    //0. read command line arguments or set default
+    std::string codebook_filename = "codebook_graz2_200_dense.out";
+    std::string model_prefix = "svm-graz2";
+    std::string problem_filename = "";
+    std::string quantization_type = "hard";
+    std::string detector_type = "Dense";
+    std::string kernel_type = "intersection";
+    std::string feature_map_type = "none";
+    double C = 1;
+    double gamma = 1;
+    bool binary_models = false;
+
+    std::string error = "Invalid arguments. Usage: [-f model-prefix] [-c codebook-filename][-d detector-type][-q quantization-type][-k kernel-type][-C cost][-p problem-filename][-m feature-map][-g gamma][-b]";
+    std::string detector_error = "detector-type must be {SIFT, Dense}";
+    std::string quant_error = "quantization-type must be {hard, soft}";
+    std::string kernel_error = "kernel-type must be {intersection, chi2}";
+    std::string feature_map_error = "feature-map must be {none, additive, fourier}";
+    for (int i = 1; i < argc; i++) {
+        std::string s(argv[i]);
+        if (s.compare("-b") == 0) {
+            binary_models = true;
+        } else if (i + 1 != argc){
+            if (s.compare("-f") == 0) {
+                model_prefix = argv[++i];
+            } else if (s.compare("-c") == 0) {
+                codebook_filename = argv[++i];
+            } else if (s.compare("-p") == 0) {
+                problem_filename = argv[++i];
+            } else if (s.compare("-C") == 0) {
+                C = atof(argv[++i]);
+            } else if (s.compare("-g") == 0) {
+                gamma = atof(argv[++i]);
+            } else if (s.compare("-m") == 0) {
+                feature_map_type = argv[++i];
+                if(feature_map_type.compare("none")!= 0 && feature_map_type.compare("additive")!= 0 && feature_map_type.compare("fourier")!= 0){
+                    std::cout << feature_map_error;
+                    return(0);
+                }
+            } else if (s.compare("-d") == 0) {
+                detector_type = argv[++i];
+                if(detector_type.compare("SIFT")!= 0 && detector_type.compare("Dense")!= 0){
+                    std::cout << detector_error;
+                    return(0);
+                }
+            } else if (s.compare("-q") == 0) {
+                quantization_type = argv[++i];
+                if(quantization_type.compare("soft")!= 0 && quantization_type.compare("hard")!= 0){
+                    std::cout << quant_error;
+                    return(0);
+                }
+            } else if (s.compare("-k") == 0) {
+                kernel_type = argv[++i];
+                if(kernel_type.compare("intersection")!= 0 && kernel_type.compare("chi2")!= 0){
+                    std::cout << kernel_error;
+                    return(0);
+                }
+            } else {
+                std::cout << error;
+                return(0);
+            }
+        } else {
+            std::cout << error;
+            return(0);
+        }
+    }
+
+    //1. histograms of the training images, labeled with their category index
+    svm_problem prob;
+    bool cached = !problem_filename.empty() && std::ifstream(problem_filename).good();
+    if(cached){
+        std::cout << "Load Problem " << problem_filename << std::endl;
+        if(!load_problem(problem_filename, prob)){
+            return 1;
+        }
+    } else {
+        if(!build_problem(prob, codebook_filename, detector_type, quantization_type)){
+            return 1;
+        }
+        if(!problem_filename.empty()){
+            save_problem_binary(problem_filename, prob);
+        }
+    }
+    if(prob.l == 0 || prob.x[0]->index != SVM_DENSE_ROW){
+        std::cout << "the problem needs dense histogram rows" << std::endl;
+        free_problem(prob);
+        return 1;
+    }
+
+    bool intersection = kernel_type.compare("intersection") == 0;
+    cv::Ptr<FeatureMap> feature_map = FeatureMap::create(feature_map_type, intersection ? IntersectionKernel : ChiSquaredKernel, (int)prob.x[0]->value, gamma);
+    if(!feature_map.empty()){
+        int status = train_mapped(prob, *feature_map, C, model_prefix, binary_models);
+        free_problem(prob);
+        return status;
+    }
+
+    //2. one kernel matrix for all categories
+    std::cout << "Compute Kernel Matrix" << std::endl;
+    GramMatrix gram;
+    gram.compute(prob.x, prob.l, intersection ? IntersectionKernel : ChiSquaredKernel);
+
+    std::vector<int> categories;
+    for(int i = 0; i < prob.l; i++){
+        categories.push_back((int)prob.y[i]);
+    }
+    std::sort(categories.begin(), categories.end());
+    categories.erase(std::unique(categories.begin(), categories.end()), categories.end());
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = std::min(omp_get_max_threads(), (int)categories.size());
+#endif
+    svm_parameter param;
+    param.svm_type = C_SVC;
+    param.kernel_type = PRECOMPUTED;
+    param.degree = 3;
+    param.gamma = 0;
+    param.coef0 = 0;
+    param.cache_size = 100.0 / threads; //the kernel values are precomputed, the cache only holds their copies
+    param.eps = 1e-3;
+    param.C = C;
+    param.nr_weight = 0;
+    param.weight_label = NULL;
+    param.weight = NULL;
+    param.nu = 0.5;
+    param.p = 0.1;
+    param.shrinking = 1;
+    param.probability = 0;
+    param.nr_thread = 1;
+    param.kernel_cache = NULL;
+
+    //3. one-vs-rest, each category against all others on the shared matrix
+    std::cout << "Train " << categories.size() << " Categories" << std::endl;
+    int failures = 0;
+#pragma omp parallel for schedule(dynamic) num_threads(threads) reduction(+:failures)
+    for(int c = 0; c < (int)categories.size(); c++){
+        std::vector<double> y(prob.l);
+        for(int i = 0; i < prob.l; i++){
+            y[i] = (int)prob.y[i] == categories[c] ? 1 : -1;
+        }
+        svm_problem category_prob;
+        category_prob.l = prob.l;
+        category_prob.y = y.data();
+        category_prob.x = gram.nodes();
+        svm_model *model = svm_train(&category_prob, &param);
+
+        //the SVs point at kernel rows, swap in their histograms so the model predicts on its own
+        for(int k = 0; k < model->l; k++){
+            model->SV[k] = prob.x[model->sv_indices[k] - 1];
+        }
+        model->param.kernel_type = intersection ? INTERSECTION : CHI_SQUARED;
+
+        std::stringstream model_filename;
+        model_filename << model_prefix << "-" << categories[c] << ".model";
+        int status = binary_models ? svm_save_model_binary(model_filename.str().c_str(), model) : svm_save_model(model_filename.str().c_str(), model);
+        if(status != 0){
+            failures++;
+        }
+#pragma omp critical
+        {
+            if(status != 0){
+                std::cout << "can't save model to file " << model_filename.str() << std::endl;
+            } else {
+                std::cout << "category " << categories[c] << ": " << model->l << " support vectors, saved to " << model_filename.str() << std::endl;
+            }
+        }
+        svm_free_and_destroy_model(&model);
+    }
+
+    free_problem(prob);
+    return failures > 0;
+}
+
+//one-vs-rest linear SVMs on the mapped histograms, each category's function w.z + b is saved as a linear libsvm model
+//with w as its single SV and rho = -b, so svm-predict applies it to problems mapped the same way (see Test)
+int train_mapped(const svm_problem &prob, const FeatureMap &feature_map, double C, const std::string &model_prefix, bool binary_models){
+    std::cout << "Map Histograms" << std::endl;
+    int dimension = (int)prob.x[0]->value;
+    cv::Mat histograms(prob.l, dimension, CV_64F);
+    std::vector<int> labels(prob.l);
+    for(int i = 0; i < prob.l; i++){
+        const double *hist = svm_dense_values(prob.x[i]);
+        std::copy(hist, hist + dimension, histograms.ptr<double>(i));
+        labels[i] = (int)prob.y[i];
+    }
+    cv::Mat features;
+    feature_map.map(histograms, features);
+
+    std::cout << "Train Linear SVM on " << features.cols << " Mapped Features" << std::endl;
+    LinearSVM svm(C); //bias 1, so the bias weight is b
+    if(!svm.train(features, labels)){
+        return 1;
+    }
+    const cv::Mat &w = svm.weights();
+    const std::vector<int> &categories = svm.classes();
+
+    svm_node **sv = svm_alloc_dense(1, features.cols);
+    double coefficient, rho;
+    double *sv_coef = &coefficient;
+    int model_labels[2] = { 1, -1 };
+    int nSV[2] = { 1, 0 };
+
+    svm_model model;
+    memset(&model, 0, sizeof(model));
+    model.param.svm_type = C_SVC;
+    model.param.kernel_type = LINEAR;
+    model.nr_class = 2;
+    model.l = 1;
+    model.SV = sv;
+    model.sv_coef = &sv_coef;
+    model.rho = &rho;
+    model.label = model_labels;
+    model.nSV = nSV;
+
+    int failures = 0;
+    for(size_t c = 0; c < categories.size(); c++){
+        //two categories share one function, positive for the first
+        int function = w.rows == 1 ? 0 : c;
+        double sign = w.rows == 1 && c == 1 ? -1 : 1;
+        const double *weights = w.ptr<double>(function);
+        std::copy(weights, weights + features.cols, svm_dense_values(sv[0]));
+        coefficient = sign;
+        rho = -sign * weights[features.cols];
+
+        std::stringstream model_filename;
+        model_filename << model_prefix << "-" << categories[c] << ".model";
+        int status = binary_models ? svm_save_model_binary(model_filename.str().c_str(), &model) : svm_save_model(model_filename.str().c_str(), &model);
+        if(status != 0){
+            std::cout << "can't save model to file " << model_filename.str() << std::endl;
+            failures++;
+        } else {
+            std::cout << "category " << categories[c] << ": linear model on mapped features, saved to " << model_filename.str() << std::endl;
+        }
+    }
+    svm_free_dense(sv);
+    return failures > 0;
+}
+
+bool build_problem(svm_problem &prob, const std::string &codebook_filename, const std::string &detector_type, const std::string &quantization_type){
+    //Load training images
+    std::cout << "Load Training Images" << std::endl;
+    std::vector<std::vector<cv::Mat>> training_images;
+    std::vector<std::string> category_labels;
+    load_graz2_train(training_images, category_labels);
+    //load_scene15_train(training_images, category_labels);
+
+    //Load codebook
+    std::cout << "Load Codebook" << std::endl;
+    std::vector<std::vector<double>> codebook;
+    if(!LoadCodebook(codebook_filename, codebook)){
+        return false;
+    }
+
+    cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create(detector_type);
+    if(detector_type.compare("Dense") == 0){
+        detector->set("initXyStep", 30); //15 for scene15, 30 for graz2
+    } else if(detector_type.compare("SIFT") == 0){
+        detector->set("nFeatures", 200);
+    }
+
+    cv::SiftDescriptorExtractor extractor; //sift128 descriptor
+
+    HardAssignment hard_quant(codebook);
+    CodewordUncertainty soft_quant(codebook, 100.0); //default smoothing value 100.0
+    Quantization *quant = &hard_quant;
+    if(quantization_type.compare("soft") == 0){
+        quant = &soft_quant;
+    }
+
+    //one dense row per image in a single block, labeled with the category index
+    int dataset_size = 0;
+    for(size_t i = 0; i < training_images.size(); i++){
+        dataset_size += training_images[i].size();
+    }
+    int histogram_size = codebook.size();
+    prob.l = dataset_size;
+    prob.y = new double[dataset_size];
+    prob.x = svm_alloc_dense(dataset_size, histogram_size);
+
+    int index = 0;
+    for(size_t i = 0; i < training_images.size(); i++){
+        std::cout << "Compute Vectors for " << category_labels[i] << " (category " << i << ")" << std::endl;
+        for(size_t j = 0; j < training_images[i].size(); j++){
+            Histogram feature_vector;
+            compute_bow_histogram(training_images[i][j], feature_vector, detector, extractor, quant);
+
+            double *hist = svm_dense_values(prob.x[index]);
+            for(int k = 0; k < histogram_size; k++){
+                hist[k] = feature_vector[k];
+            }
+            prob.y[index] = i;
+            index++;
+        }
+    }
+    return true;
+}
+
+void compute_bow_histogram(const cv::Mat &sample, Histogram &feature_vector, cv::Ptr<cv::FeatureDetector> &detector, cv::SiftDescriptorExtractor &extractor, Quantization *quant){
+    //detect keypoints
+    std::vector<cv::KeyPoint> keypoints;
+    detector->detect( sample, keypoints );
+
+    //compute descriptor
+    cv::Mat descriptor_uchar;
+    extractor.compute(sample, keypoints, descriptor_uchar);
+
+    cv::Mat descriptor_double;
+    descriptor_uchar.convertTo(descriptor_double, CV_64F);
+
+    //convert from mat to bag of unquantized features
+    BagOfFeatures unquantized_features;
+    convert_mat_to_vector(descriptor_double, unquantized_features);
+
+    //quantize regions -- true BagOfFeatures
+    quant->quantize(unquantized_features, feature_vector);
+}
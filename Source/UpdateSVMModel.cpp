@@ -0,0 +1,72 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "SVM/svm.h"
+#include "SVM/IncrementalTraining.hpp"
+#include "SVM/Problem.hpp"
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+//retrains a C-SVC model with new labeled samples instead of from scratch
+//new-problem holds only the new samples (libsvm text format); with previous-problem, the file the model was trained on,
+//the result matches full retraining, without it only the old SVs are kept
+int main(int argc, char **argv){
+    std::string error = "Invalid arguments. Usage: model new-problem C output-model [previous-problem]";
+    if(argc != 5 && argc != 6){
+        std::cout << error << std::endl;
+        return 1;
+    }
+
+    svm_model *model = svm_load_model(argv[1]);
+    if(model == NULL){
+        std::cout << "can't open model file " << argv[1] << std::endl;
+        return 1;
+    }
+    svm_problem added, previous;
+    if(!load_problem(argv[2], added)){
+        svm_free_and_destroy_model(&model);
+        return 1;
+    }
+    bool has_previous = argc == 6;
+    if(has_previous && !load_problem(argv[5], previous)){
+        free_problem(added);
+        svm_free_and_destroy_model(&model);
+        return 1;
+    }
+
+    svm_parameter param = model->param;
+    param.C = atof(argv[3]);
+    param.cache_size = 100;
+    param.eps = 1e-3;
+    param.nr_weight = 0;
+    param.weight_label = NULL;
+    param.weight = NULL;
+    param.shrinking = 1;
+    param.probability = model->probA != NULL;
+#ifdef _OPENMP
+    param.nr_thread = omp_get_max_threads();
+#else
+    param.nr_thread = 1;
+#endif
+
+    int status = 1;
+    svm_model *updated = train_incremental(model, &added, param, has_previous ? &previous : NULL);
+    if(updated != NULL){
+        //the model is saved in the format of the input
+        status = svm_is_binary_model(argv[1]) ? svm_save_model_binary(argv[4], updated) : svm_save_model(argv[4], updated);
+        if(status != 0){
+            std::cout << "can't save model to file " << argv[4] << std::endl;
+        }
+        svm_free_and_destroy_model(&updated);
+    }
+
+    if(has_previous){
+        free_problem(previous);
+    }
+    free_problem(added);
+    svm_free_and_destroy_model(&model);
+    return status != 0;
+}
@@ -214,6 +214,134 @@ double LocalDescriptorAndBagOfFeature::kmeans(std::vector<std::vector<double>> &
     return best_compactness;
 }
 
+/**
+ * @brief LocalDescriptorAndBagOfFeature::approximate_kmeans - approximate k-means (Philbin et al.) for large flat vocabularies
+ * @param trees -- number of randomized kd-trees built over the current centers each iteration
+ * @param checks -- maximum number of leaves visited when assigning a sample
+ * @return same outputs as kmeans, the compactness is computed exactly
+ *
+ * - Same seeding and termination conditions as kmeans.
+ * - The exact O(N*K) assignment step is replaced by a bounded search in a kd-forest (cv::flann), rebuilt every iteration.
+ * - Bin sums are recomputed each iteration instead of moving samples between bins.
+ */
+double LocalDescriptorAndBagOfFeature::approximate_kmeans(std::vector<std::vector<double>> &input, int K, std::vector<int> &labels, std::vector<std::vector<double>> &centers, std::vector<int> &sizes, int iteration_bound, int epsilon, int trees, int checks){
+    int sample_ct = input.size();
+    int dim = input[0].size();
+
+    //1.initial seeding of cluster centers, identical to kmeans
+    std::vector<bin_info> totals(K);
+
+    for(bin_info& binfo : totals){
+        binfo.size = 0;
+        binfo.sum.resize(dim);
+        binfo.mean.resize(dim);
+    }
+
+    for(int i = 0; i < K; i++){
+        int index = i + std::rand()%(sample_ct-i);
+        std::vector<double> v(input[index]);
+        totals[i].mean = v;
+        std::swap(input[index], input[i]);
+    }
+
+    //flann only indexes single precision data, the samples are converted once
+    cv::Mat samples(sample_ct, dim, CV_32F);
+    for(int i = 0; i < sample_ct; i++){
+        float* p = samples.ptr<float>(i);
+        std::copy(input[i].begin(), input[i].end(), p);
+    }
+
+    std::vector<int> current_bins(sample_ct, -1);
+    cv::Mat center_mat(K, dim, CV_32F);
+    cv::Mat nearest(sample_ct, 1, CV_32S);
+    cv::Mat nearest_distance(sample_ct, 1, CV_32F);
+
+    bool recompute = true;
+    int iteration_ct = 0;
+    while(recompute && iteration_ct < iteration_bound){
+        if(input.size() > 25000){
+            std::cout << input.size() << " samples... approximate iteration: " << iteration_ct << std::endl;
+        }
+        iteration_ct++;
+
+        //2. build the forest over the current centers and look up the (approximately) nearest one for each sample
+        for(int j = 0; j < K; j++){
+            float* p = center_mat.ptr<float>(j);
+            std::copy(totals[j].mean.begin(), totals[j].mean.end(), p);
+        }
+        cv::flann::Index forest(center_mat, cv::flann::KDTreeIndexParams(trees));
+        forest.knnSearch(samples, nearest, nearest_distance, 1, cv::flann::SearchParams(checks));
+
+        //3. rebuild the bins from the new assignment
+        recompute = false;
+        for(bin_info& binfo : totals){
+            binfo.size = 0;
+            std::fill(binfo.sum.begin(), binfo.sum.end(), 0.0);
+        }
+        for(int i = 0; i < sample_ct; i++){
+            int bin = nearest.at<int>(i, 0);
+            if(bin != current_bins[i]){
+                current_bins[i] = bin;
+                recompute = true; //state changed, so run another iteration
+            }
+            totals[bin].size++;
+            vector_add(totals[bin].sum, input[i]);
+        }
+
+        //4. recompute mean for new centers -- keeping track of how much it moved
+        double max_move = 0;
+        for(bin_info& binfo : totals){
+            if(binfo.size == 0){
+                std::cout << "A bin is empty... re-assign random sample to it" << std::endl;
+                int index = std::rand()%(sample_ct);
+                std::vector<double> v(input[index]);
+                binfo.mean = v;
+            } else {
+                double sum = 0.0;
+                for(int i = 0; i < dim; i++){
+                    double old_value = binfo.mean[i];
+                    double new_value = binfo.sum[i]/binfo.size;
+                    binfo.mean[i] = new_value;
+
+                    sum += ((old_value - new_value)*(old_value - new_value));
+                }
+                if(sum > max_move)
+                    max_move = sum;
+            }
+        }
+
+        if(input.size() > 25000)
+            std::cout << "max center shift: " << max_move << std::endl;
+
+        if(max_move < epsilon){
+            recompute = false;
+        }
+    }
+
+    //5. approximate local minimum reached, hand back results as kmeans does
+    centers.clear();
+    sizes.clear();
+    for(bin_info& binfo : totals){
+        centers.push_back(binfo.mean);
+        sizes.push_back(binfo.size);
+    }
+
+    labels.clear();
+    for(int& i: current_bins){
+        labels.push_back(i);
+    }
+
+    //6. compactness, exact distances so it is comparable with kmeans
+    double sum = 0.0;
+    for(int i = 0; i < sample_ct; i++){
+        double distance = euclidean_distance(input[i], centers[labels[i]]);
+        sum += distance*distance;
+    }
+    sum /= sample_ct;
+
+    return sum;
+}
+
 //the tree's K and L should be set prior to call, the tree will then be populated by the algorithm
 void LocalDescriptorAndBagOfFeature::hierarchical_kmeans(std::vector<std::vector<double>> &input, vocabulary_tree &tree){
     hierarchical_kmeans(input, tree.K, tree.L, tree.root);
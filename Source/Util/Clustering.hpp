@@ -28,6 +28,8 @@ namespace LocalDescriptorAndBagOfFeature {
     double kmeans(std::vector<std::vector<double>> &input, int K, std::vector<int> &labels, std::vector<std::vector<double>> &centers, std::vector<int> &sizes, int iteration_bound, int epsilon);
     //multiple run, returning the best
     double kmeans(std::vector<std::vector<double>> &input, int K, std::vector<int> &labels, std::vector<std::vector<double>> &centers, std::vector<int> &sizes, int iteration_bound, int epsilon, int trials);
+    //approximate, assignment through a randomized kd-forest over the centers, trees is the forest size, checks bounds the leaves visited per sample
+    double approximate_kmeans(std::vector<std::vector<double>> &input, int K, std::vector<int> &labels, std::vector<std::vector<double>> &centers, std::vector<int> &sizes, int iteration_bound, int epsilon, int trees, int checks);
     //hierarchical, K is the branching factor, L is the number of levels
     void hierarchical_kmeans(std::vector<std::vector<double>> &input, vocabulary_tree &tree);
     void hierarchical_kmeans(std::vector<std::vector<double>> &input, int K, int L, tree_node &root);
@@ -0,0 +1,59 @@
+#include "MappedFile.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+struct MappedFile::mapping_info {
+    char *data;
+    size_t size;
+
+    ~mapping_info(){
+        if(data != nullptr)
+            munmap(data, size);
+    }
+};
+
+MappedFile::MappedFile(){
+}
+
+bool MappedFile::open(const std::string &filename){
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0){
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        ::close(fd);
+        return false;
+    }
+
+    //MAP_PRIVATE with write access: callers may modify what they loaded without touching the file
+    void *p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED){
+        return false;
+    }
+
+    mapping = std::make_shared<mapping_info>();
+    mapping->data = static_cast<char*>(p);
+    mapping->size = st.st_size;
+    return true;
+}
+
+void MappedFile::close(){
+    mapping.reset();
+}
+
+char *MappedFile::data() const {
+    return mapping ? mapping->data : nullptr;
+}
+
+size_t MappedFile::size() const {
+    return mapping ? mapping->size : 0;
+}
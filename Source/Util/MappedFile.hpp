@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <cstddef>
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    //private (copy-on-write) memory mapping of a whole file, callers can build headers straight over the bytes
+    //copies share the mapping, it is unmapped when the last one goes away
+    class MappedFile {
+        public:
+            MappedFile();
+            bool open(const std::string &filename);
+            void close();
+
+            bool is_open() const { return mapping != nullptr; }
+            char *data() const;
+            size_t size() const;
+
+        private:
+            struct mapping_info;
+            std::shared_ptr<mapping_info> mapping;
+    };
+}
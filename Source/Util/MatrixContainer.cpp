@@ -0,0 +1,206 @@
+#include "MatrixContainer.hpp"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <climits>
+
+using namespace LocalDescriptorAndBagOfFeature;
+
+namespace {
+    //fixed size so the payload always starts on a 64 byte boundary of the page aligned mapping
+    struct container_header {
+        char magic[8];
+        std::int32_t version;
+        std::int32_t kind;
+        std::int32_t dtype;             //CV_64F or CV_32F
+        std::int32_t dimension;
+        std::int64_t count;
+        std::uint64_t labels_offset;    //from the start of the file, 0 if the rows carry no labels
+        std::uint64_t labels_bytes;
+        std::uint64_t file_bytes;
+        std::uint64_t checksum;         //over everything after the header
+        std::int32_t step;
+        std::int32_t features;
+        char detector[32];
+        char descriptor[32];
+        char quantization[32];
+        char reserved[88];
+    };
+    static_assert(sizeof(container_header) == 256, "the payload must stay 64 byte aligned");
+
+    const char container_magic[8] = { 'L', 'D', 'B', 'O', 'F', 'M', 'A', 'T' };
+    const std::int32_t container_version = 1;
+
+    size_t align8(size_t n){
+        return (n + 7) & ~(size_t)7;
+    }
+
+    //FNV-1a over 64 bit words, every section is zero padded to a multiple of 8 bytes
+    std::uint64_t checksum(const char *data, size_t bytes){
+        std::uint64_t h = 14695981039346656037ULL;
+        size_t words = bytes / sizeof(std::uint64_t);
+        for(size_t i = 0; i < words; i++){
+            std::uint64_t w;
+            std::memcpy(&w, data + i * sizeof(w), sizeof(w));
+            h ^= w;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    void copy_field(char *field, size_t size, const std::string &value){
+        std::strncpy(field, value.c_str(), size - 1);
+    }
+
+    std::string read_field(const char *field, size_t size){
+        return std::string(field, strnlen(field, size));
+    }
+}
+
+bool matrix_container::save(const std::string &filename, container_kind kind, const cv::Mat &rows, const std::vector<std::string> &labels, const feature_parameters &parameters){
+    if(rows.type() != CV_64F && rows.type() != CV_32F){
+        std::cout << "container rows must be CV_64F or CV_32F" << std::endl;
+        return false;
+    }
+    if(!labels.empty() && labels.size() != (size_t)rows.rows){
+        std::cout << "container has " << rows.rows << " rows but " << labels.size() << " labels" << std::endl;
+        return false;
+    }
+
+    cv::Mat continuous = rows.isContinuous() ? rows : rows.clone();
+    size_t payload_bytes = continuous.total() * continuous.elemSize();
+
+    //body is the payload and the labels with their padding, exactly as it will sit in the file
+    std::string body(align8(payload_bytes), '\0');
+    if(payload_bytes > 0)
+        std::memcpy(&body[0], continuous.data, payload_bytes);
+    size_t labels_bytes = 0;
+    for(const std::string &label : labels){
+        body.append(label.c_str(), label.size() + 1);
+        labels_bytes += label.size() + 1;
+    }
+    body.resize(align8(body.size()), '\0');
+
+    container_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, container_magic, sizeof(container_magic));
+    header.version = container_version;
+    header.kind = kind;
+    header.dtype = rows.type();
+    header.dimension = rows.cols;
+    header.count = rows.rows;
+    header.labels_offset = labels.empty() ? 0 : sizeof(header) + align8(payload_bytes);
+    header.labels_bytes = labels_bytes;
+    header.file_bytes = sizeof(header) + body.size();
+    header.checksum = checksum(body.data(), body.size());
+    header.step = parameters.step;
+    header.features = parameters.features;
+    copy_field(header.detector, sizeof(header.detector), parameters.detector);
+    copy_field(header.descriptor, sizeof(header.descriptor), parameters.descriptor);
+    copy_field(header.quantization, sizeof(header.quantization), parameters.quantization);
+
+    std::ofstream fileout(filename, std::ios::binary);
+    fileout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fileout.write(body.data(), body.size());
+    return fileout.good();
+}
+
+bool matrix_container::save(const std::string &filename, container_kind kind, const std::vector<std::vector<double>> &rows, const std::vector<std::string> &labels, const feature_parameters &parameters){
+    size_t dimension = rows.empty() ? 0 : rows[0].size();
+    cv::Mat m(rows.size(), dimension, CV_64F);
+    for(size_t i = 0; i < rows.size(); i++){
+        if(rows[i].size() != dimension){
+            std::cout << "container row " << i << " has " << rows[i].size() << " values, expected " << dimension << std::endl;
+            return false;
+        }
+        std::copy(rows[i].begin(), rows[i].end(), m.ptr<double>(i));
+    }
+    return save(filename, kind, m, labels, parameters);
+}
+
+bool matrix_container::is_container(const std::string &filename){
+    std::ifstream filein(filename, std::ios::binary);
+    char magic[sizeof(container_magic)];
+    return filein.read(magic, sizeof(magic)) && std::memcmp(magic, container_magic, sizeof(magic)) == 0;
+}
+
+bool matrix_container::open(const std::string &filename, container_kind kind, bool verify){
+    MappedFile file;
+    if(!file.open(filename) || file.size() < sizeof(container_header)){
+        std::cout << "can't open container " << filename << std::endl;
+        return false;
+    }
+
+    const container_header *header = reinterpret_cast<const container_header*>(file.data());
+    if(std::memcmp(header->magic, container_magic, sizeof(container_magic)) != 0 || header->version != container_version){
+        std::cout << filename << " is not a version " << container_version << " container" << std::endl;
+        return false;
+    }
+    if(header->kind != kind){
+        std::cout << filename << " holds a different kind of container" << std::endl;
+        return false;
+    }
+
+    //sizes are checked against the file before they are multiplied, so a corrupt header can't wrap them
+    size_t elem_size = header->dtype == CV_64F ? sizeof(double) : sizeof(float);
+    if(header->count < 0 || header->dimension < 0 || header->count > INT_MAX
+            || (header->dimension > 0 && (std::uint64_t)header->count > file.size() / ((size_t)header->dimension * elem_size))
+            || header->labels_offset > file.size() || header->labels_bytes > file.size()){
+        std::cout << filename << " has an inconsistent header" << std::endl;
+        return false;
+    }
+    size_t payload_bytes = (size_t)header->count * header->dimension * elem_size;
+    bool labeled = header->labels_offset != 0;
+    size_t labels_end = labeled ? header->labels_offset + header->labels_bytes : 0;
+    if((header->dtype != CV_64F && header->dtype != CV_32F) || header->file_bytes != file.size()
+            || align8(sizeof(container_header) + payload_bytes) > file.size() || labels_end > file.size()
+            || (labeled && header->labels_offset < sizeof(container_header) + payload_bytes)){
+        std::cout << filename << " is truncated or has an inconsistent header" << std::endl;
+        return false;
+    }
+
+    const char *body = file.data() + sizeof(container_header);
+    if(verify && checksum(body, file.size() - sizeof(container_header)) != header->checksum){
+        std::cout << filename << " failed its checksum" << std::endl;
+        return false;
+    }
+
+    //labels are nul terminated back to back, only their count is checked against the rows
+    std::vector<std::string> labels;
+    if(labeled){
+        const char *label = file.data() + header->labels_offset;
+        const char *end = file.data() + labels_end;
+        while(label < end){
+            size_t length = strnlen(label, end - label);
+            labels.push_back(std::string(label, length));
+            label += length + 1;
+        }
+        if(labels.size() != (size_t)header->count){
+            std::cout << filename << " has " << header->count << " rows but " << labels.size() << " labels" << std::endl;
+            return false;
+        }
+    }
+
+    matrix = cv::Mat((int)header->count, header->dimension, header->dtype, const_cast<char*>(body));
+    row_labels.swap(labels);
+    params.detector = read_field(header->detector, sizeof(header->detector));
+    params.descriptor = read_field(header->descriptor, sizeof(header->descriptor));
+    params.quantization = read_field(header->quantization, sizeof(header->quantization));
+    params.step = header->step;
+    params.features = header->features;
+    storage = file;
+    return true;
+}
+
+void matrix_container::copy_rows(std::vector<std::vector<double>> &rows) const{
+    cv::Mat values = matrix;
+    if(matrix.type() != CV_64F)
+        matrix.convertTo(values, CV_64F);
+    rows.resize(values.rows);
+    for(int i = 0; i < values.rows; i++){
+        const double *row = values.ptr<double>(i);
+        rows[i].assign(row, row + values.cols);
+    }
+}
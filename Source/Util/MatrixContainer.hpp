@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "MappedFile.hpp"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    //what the rows of a container are, checked on open so a classifier is never read back as a codebook
+    enum container_kind {
+        CODEBOOK_CONTAINER = 1,
+        CLASSIFIER_CONTAINER = 2
+    };
+
+    //detector/descriptor settings the rows were computed with, rows are only meaningful to the same pipeline
+    struct feature_parameters {
+        std::string detector;       //"Dense" or "SIFT"
+        std::string descriptor;     //"SIFT"
+        std::string quantization;   //"hard", "soft" or "tree", empty for a codebook
+        int step;                   //dense detector grid step (initXyStep), 0 if unused
+        int features;               //SIFT detector feature count (nFeatures), 0 if unused
+
+        feature_parameters() : step(0), features(0) {}
+    };
+
+    //versioned binary file of count x dimension rows, CV_64F or CV_32F:
+    //a 256 byte header (magic, version, kind, dtype, dimension, count, feature parameters, checksum),
+    //the rows as one contiguous payload on a 64 byte boundary, then the row labels as nul terminated strings
+    //open() maps the file and rows() is a matrix header over the mapping, nothing is parsed
+    class matrix_container {
+        public:
+            static bool save(const std::string &filename, container_kind kind, const cv::Mat &rows, const std::vector<std::string> &labels, const feature_parameters &parameters);
+            static bool save(const std::string &filename, container_kind kind, const std::vector<std::vector<double>> &rows, const std::vector<std::string> &labels, const feature_parameters &parameters);
+            static bool is_container(const std::string &filename);
+
+            //verify recomputes the checksum, one pass over the payload
+            bool open(const std::string &filename, container_kind kind, bool verify = true);
+
+            const cv::Mat &rows() const { return matrix; }
+            const std::vector<std::string> &labels() const { return row_labels; }
+            const feature_parameters &parameters() const { return params; }
+
+            //for callers that still take nested vectors, a copy but no parsing
+            void copy_rows(std::vector<std::vector<double>> &rows) const;
+
+        private:
+            MappedFile storage;
+            cv::Mat matrix;
+            std::vector<std::string> row_labels;
+            feature_parameters params;
+    };
+}
@@ -0,0 +1,401 @@
+#include "ShardedClustering.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+namespace {
+    const int command_assign = 0;
+    const int command_finish = 1;
+    const int poll_interval = 1000; //microseconds between checks of the work directory
+
+    std::string shared_path(const std::string &work_dir, const std::string &name, int a, int b = -1){
+        std::ostringstream convert;
+        convert << work_dir << "/" << name << "." << a;
+        if(b >= 0)
+            convert << "." << b;
+        return convert.str();
+    }
+
+    bool file_exists(const std::string &path){
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    //files are written under a temporary name and renamed, so a reader never sees a partial file
+    void publish(const std::string &path){
+        std::string tmp = path + ".tmp";
+        std::rename(tmp.c_str(), path.c_str());
+    }
+
+    //contiguous block of rows owned by a shard
+    void shard_range(int sample_ct, int shard, int shards, int &first, int &count){
+        first = (long long)sample_ct * shard / shards;
+        count = (long long)sample_ct * (shard + 1) / shards - first;
+    }
+
+    template<class T> void write_values(std::ofstream &fileout, const T *values, int count){
+        fileout.write(reinterpret_cast<const char*>(values), sizeof(T) * count);
+    }
+
+    template<class T> void read_values(std::ifstream &filein, T *values, int count){
+        filein.read(reinterpret_cast<char*>(values), sizeof(T) * count);
+    }
+
+    void write_centers(const std::string &path, int command, const std::vector<std::vector<double>> &means){
+        int K = means.size();
+        int dim = means[0].size();
+        std::ofstream fileout (path + ".tmp", std::ios::binary);
+        write_values(fileout, &command, 1);
+        write_values(fileout, &K, 1);
+        write_values(fileout, &dim, 1);
+        for(const std::vector<double>& mean : means){
+            write_values(fileout, mean.data(), dim);
+        }
+        fileout.close();
+        publish(path);
+    }
+
+    int read_centers(const std::string &path, std::vector<std::vector<double>> &means){
+        int command, K, dim;
+        std::ifstream filein (path, std::ios::binary);
+        read_values(filein, &command, 1);
+        read_values(filein, &K, 1);
+        read_values(filein, &dim, 1);
+        means.resize(K);
+        for(std::vector<double>& mean : means){
+            mean.resize(dim);
+            read_values(filein, mean.data(), dim);
+        }
+        filein.close();
+        return command;
+    }
+
+    //the exchange files of a run, centers.*, partial.* and final.* with their temporaries
+    void clear_work_dir(const std::string &work_dir){
+        DIR *dir = opendir(work_dir.c_str());
+        if(dir == NULL)
+            return;
+        for(struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)){
+            std::string name(entry->d_name);
+            if(name.compare(0, 8, "centers.") == 0 || name.compare(0, 8, "partial.") == 0 || name.compare(0, 6, "final.") == 0){
+                std::remove((work_dir + "/" + name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+
+    //a forked worker is re-parented when the coordinator dies, a separately launched one can only probe the pid
+    bool coordinator_alive(pid_t coordinator, bool forked){
+        if(forked && getppid() != coordinator)
+            return false;
+        return kill(coordinator, 0) == 0 || errno != ESRCH;
+    }
+
+    //worker side: blocks until path appears, returns false if the coordinator that writes it is gone
+    bool wait_for_coordinator(const std::string &path, pid_t coordinator, bool forked){
+        while(!file_exists(path)){
+            if(!coordinator_alive(coordinator, forked)){
+                std::cout << "k-means coordinator " << coordinator << " exited, worker stops" << std::endl;
+                return false;
+            }
+            usleep(poll_interval);
+        }
+        return true;
+    }
+
+    //blocks until path appears, returns false if the worker expected to write it died first
+    bool wait_for(const std::string &path, pid_t worker){
+        while(!file_exists(path)){
+            int status;
+            if(worker > 0 && waitpid(worker, &status, WNOHANG) == worker){
+                //the worker may have published right before exiting
+                if(file_exists(path))
+                    return true;
+                std::cout << "k-means worker " << worker << " exited early" << std::endl;
+                return false;
+            }
+            usleep(poll_interval);
+        }
+        return true;
+    }
+}
+
+void LocalDescriptorAndBagOfFeature::save_descriptors(std::string filename, const std::vector<std::vector<double>> &samples){
+    int sample_ct = samples.size();
+    int dim = samples.empty() ? 0 : samples[0].size();
+    std::ofstream fileout (filename, std::ios::binary);
+    write_values(fileout, &sample_ct, 1);
+    write_values(fileout, &dim, 1);
+    for(const std::vector<double>& sample : samples){
+        write_values(fileout, sample.data(), dim);
+    }
+    fileout.close();
+}
+
+bool LocalDescriptorAndBagOfFeature::read_descriptor_header(std::string filename, int &sample_ct, int &dim){
+    std::ifstream filein (filename, std::ios::binary);
+    read_values(filein, &sample_ct, 1);
+    read_values(filein, &dim, 1);
+    return filein.good();
+}
+
+//loads count samples starting at row first, so each worker only reads its own shard
+void LocalDescriptorAndBagOfFeature::load_descriptors(std::string filename, int first, int count, std::vector<std::vector<double>> &samples){
+    int sample_ct, dim;
+    std::ifstream filein (filename, std::ios::binary);
+    read_values(filein, &sample_ct, 1);
+    read_values(filein, &dim, 1);
+    filein.seekg(2 * sizeof(int) + (std::streamoff)first * dim * sizeof(double));
+    for(int i = 0; i < count; i++){
+        std::vector<double> sample(dim);
+        read_values(filein, sample.data(), dim);
+        samples.push_back(sample);
+    }
+    filein.close();
+}
+
+/**
+ * @brief LocalDescriptorAndBagOfFeature::kmeans_worker - assignment step of sharded k-means for one shard
+ *
+ * For every iteration the coordinator publishes centers.<iteration>, the worker answers with
+ * partial.<iteration>.<shard>: number of changed labels, per-center counts and per-center sums.
+ * On the finish command it answers with final.<shard>: compactness sum and the shard's labels.
+ */
+void LocalDescriptorAndBagOfFeature::kmeans_worker(std::string descriptor_filename, std::string work_dir, int shard, int shards, pid_t coordinator){
+    bool forked = getppid() == coordinator;
+    int sample_ct, dim, first, count;
+    read_descriptor_header(descriptor_filename, sample_ct, dim);
+    shard_range(sample_ct, shard, shards, first, count);
+
+    std::vector<std::vector<double>> samples;
+    load_descriptors(descriptor_filename, first, count, samples);
+
+    std::vector<int> current_bins(count, -1);
+    std::vector<std::vector<double>> means;
+
+    for(int iteration = 0; ; iteration++){
+        std::string centers_path = shared_path(work_dir, "centers", iteration);
+        if(!wait_for_coordinator(centers_path, coordinator, forked))
+            return;
+        int command = read_centers(centers_path, means);
+        int K = means.size();
+
+        if(command == command_finish){
+            double sum = 0.0;
+            for(int i = 0; i < count; i++){
+                double distance = euclidean_distance(samples[i], means[current_bins[i]]);
+                sum += distance*distance;
+            }
+
+            std::string final_path = shared_path(work_dir, "final", shard);
+            std::ofstream fileout (final_path + ".tmp", std::ios::binary);
+            write_values(fileout, &sum, 1);
+            write_values(fileout, &count, 1);
+            write_values(fileout, current_bins.data(), count);
+            fileout.close();
+            publish(final_path);
+            return;
+        }
+
+        //same nearest-center rule as kmeans, ties go to the lowest index
+        int changed = 0;
+        std::vector<int> sizes(K, 0);
+        std::vector<std::vector<double>> sums(K, std::vector<double>(dim, 0.0));
+        for(int i = 0; i < count; i++){
+            int nearest_bin = 0;
+            double nearest_distance = euclidean_distance(samples[i], means[0]);
+            for(int j = 1; j < K; j++){
+                double distance = euclidean_distance(samples[i], means[j]);
+                if(distance < nearest_distance){
+                    nearest_bin = j;
+                    nearest_distance = distance;
+                }
+            }
+
+            if(nearest_bin != current_bins[i]){
+                current_bins[i] = nearest_bin;
+                changed++;
+            }
+            sizes[nearest_bin]++;
+            vector_add(sums[nearest_bin], samples[i]);
+        }
+
+        std::string partial_path = shared_path(work_dir, "partial", iteration, shard);
+        std::ofstream fileout (partial_path + ".tmp", std::ios::binary);
+        write_values(fileout, &changed, 1);
+        write_values(fileout, sizes.data(), K);
+        for(std::vector<double>& sum : sums){
+            write_values(fileout, sum.data(), dim);
+        }
+        fileout.close();
+        publish(partial_path);
+    }
+}
+
+/**
+ * @brief LocalDescriptorAndBagOfFeature::sharded_kmeans - kmeans with the assignment step spread over worker processes
+ * @param descriptor_filename -- samples written by save_descriptors
+ * @param work_dir -- directory shared by coordinator and workers, created if missing
+ * @param shards -- number of worker processes, each owning a contiguous block of rows
+ * @return same outputs as kmeans, labels are in file order
+ *
+ * The coordinator draws the initial centers and the empty-bin reseeds from std::rand in the same order as kmeans
+ * (tracking the permutation kmeans applies to its input), so with the same seed both produce the same clustering,
+ * up to floating point summation order in the center sums.
+ */
+double LocalDescriptorAndBagOfFeature::sharded_kmeans(std::string descriptor_filename, std::string work_dir, int shards, int K, std::vector<int> &labels, std::vector<std::vector<double>> &centers, std::vector<int> &sizes, int iteration_bound, int epsilon){
+    int sample_ct, dim;
+    if(!read_descriptor_header(descriptor_filename, sample_ct, dim)){
+        std::cout << "could not read descriptor file " << descriptor_filename << std::endl;
+        return -1;
+    }
+    mkdir(work_dir.c_str(), 0755);
+    clear_work_dir(work_dir);
+
+    //1. initial seeding, same draws as kmeans
+    std::vector<int> order(sample_ct);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<std::vector<double>> means;
+    for(int i = 0; i < K; i++){
+        int index = i + std::rand()%(sample_ct-i);
+        load_descriptors(descriptor_filename, order[index], 1, means);
+        std::swap(order[index], order[i]);
+    }
+
+    //2. start one worker per shard
+    std::cout.flush();
+    pid_t coordinator = getpid();
+    std::vector<pid_t> workers;
+    for(int s = 0; s < shards; s++){
+        pid_t pid = fork();
+        if(pid == 0){
+            kmeans_worker(descriptor_filename, work_dir, s, shards, coordinator);
+            _exit(0);
+        }
+        workers.push_back(pid);
+    }
+
+    std::vector<int> bin_sizes(K, 0);
+    bool failed = false;
+    bool recompute = true;
+    int iteration_ct = 0;
+    while(recompute && iteration_ct < iteration_bound){
+        if(sample_ct > 25000){
+            std::cout << sample_ct << " samples over " << shards << " shards... iteration: " << iteration_ct << std::endl;
+        }
+
+        //3. broadcast centers and reduce the partial sums in shard order
+        std::string centers_path = shared_path(work_dir, "centers", iteration_ct);
+        write_centers(centers_path, command_assign, means);
+
+        int changed = 0;
+        std::fill(bin_sizes.begin(), bin_sizes.end(), 0);
+        std::vector<std::vector<double>> sums(K, std::vector<double>(dim, 0.0));
+        for(int s = 0; s < shards && !failed; s++){
+            std::string partial_path = shared_path(work_dir, "partial", iteration_ct, s);
+            if(!wait_for(partial_path, workers[s])){
+                failed = true;
+                break;
+            }
+
+            int shard_changed;
+            std::vector<int> shard_sizes(K);
+            std::vector<double> shard_sum(dim);
+            std::ifstream filein (partial_path, std::ios::binary);
+            read_values(filein, &shard_changed, 1);
+            read_values(filein, shard_sizes.data(), K);
+            changed += shard_changed;
+            for(int j = 0; j < K; j++){
+                bin_sizes[j] += shard_sizes[j];
+                read_values(filein, shard_sum.data(), dim);
+                vector_add(sums[j], shard_sum);
+            }
+            filein.close();
+            std::remove(partial_path.c_str());
+        }
+        std::remove(centers_path.c_str());
+        if(failed)
+            break;
+        iteration_ct++;
+
+        recompute = changed > 0;
+
+        //4. recompute mean for new centers -- keeping track of how much it moved
+        double max_move = 0;
+        for(int j = 0; j < K; j++){
+            if(bin_sizes[j] == 0){
+                std::cout << "A bin is empty... re-assign random sample to it" << std::endl;
+                int index = std::rand()%(sample_ct);
+                std::vector<std::vector<double>> reseed;
+                load_descriptors(descriptor_filename, order[index], 1, reseed);
+                means[j] = reseed[0];
+            } else {
+                double sum = 0.0;
+                for(int i = 0; i < dim; i++){
+                    double old_value = means[j][i];
+                    double new_value = sums[j][i]/bin_sizes[j];
+                    means[j][i] = new_value;
+
+                    sum += ((old_value - new_value)*(old_value - new_value));
+                }
+                if(sum > max_move)
+                    max_move = sum;
+            }
+        }
+
+        if(sample_ct > 25000)
+            std::cout << "max center shift: " << max_move << std::endl;
+
+        if(max_move < epsilon){
+            recompute = false;
+        }
+    }
+
+    //5. tell the workers to finish, collecting labels and compactness
+    double sum = 0.0;
+    labels.clear();
+    std::string centers_path = shared_path(work_dir, "centers", iteration_ct);
+    write_centers(centers_path, command_finish, means);
+    for(int s = 0; s < shards && !failed; s++){
+        std::string final_path = shared_path(work_dir, "final", s);
+        if(!wait_for(final_path, workers[s])){
+            failed = true;
+            break;
+        }
+
+        double shard_sum;
+        int count;
+        std::ifstream filein (final_path, std::ios::binary);
+        read_values(filein, &shard_sum, 1);
+        read_values(filein, &count, 1);
+        std::vector<int> shard_labels(count);
+        read_values(filein, shard_labels.data(), count);
+        filein.close();
+        std::remove(final_path.c_str());
+
+        sum += shard_sum;
+        labels.insert(labels.end(), shard_labels.begin(), shard_labels.end());
+    }
+    std::remove(centers_path.c_str());
+
+    for(pid_t pid : workers){
+        if(failed)
+            kill(pid, SIGTERM);
+        int status;
+        waitpid(pid, &status, 0);
+    }
+    if(failed)
+        return -1;
+
+    centers = means;
+    sizes = bin_sizes;
+
+    return sum / sample_ct;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <sys/types.h>
+#include "Clustering.hpp"
+
+namespace LocalDescriptorAndBagOfFeature {
+
+    //binary descriptor file: sample count and dimension as ints, followed by the samples as doubles, row by row
+    void save_descriptors(std::string filename, const std::vector<std::vector<double>> &samples);
+    bool read_descriptor_header(std::string filename, int &sample_ct, int &dim);
+    void load_descriptors(std::string filename, int first, int count, std::vector<std::vector<double>> &samples);
+
+    //k-means over a descriptor file split into shards, one worker process per shard (forked from the caller)
+    //workers and coordinator exchange centers and partial sums as files in work_dir, left over files of an aborted run are cleared first
+    //follows the same random sequence as the single process kmeans, so the same seed gives the same clustering
+    double sharded_kmeans(std::string descriptor_filename, std::string work_dir, int shards, int K, std::vector<int> &labels, std::vector<std::vector<double>> &centers, std::vector<int> &sizes, int iteration_bound, int epsilon);
+    //worker side, run in the processes sharded_kmeans forks, one per shard
+    //gives up and returns when the coordinator process exits before publishing the next centers
+    void kmeans_worker(std::string descriptor_filename, std::string work_dir, int shard, int shards, pid_t coordinator);
+}
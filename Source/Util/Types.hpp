@@ -5,4 +5,7 @@ namespace LocalDescriptorAndBagOfFeature
     typedef std::vector<double> Histogram;
     typedef std::vector<Histogram> BagOfFeatures;
     typedef std::vector<BagOfFeatures> FeatureSet;
+
+    //additive kernels between histograms, shared by the Gram matrices and the explicit feature maps
+    enum HistogramKernel { ChiSquaredKernel, IntersectionKernel, HellingerKernel };
 }